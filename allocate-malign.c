@@ -26,5 +26,28 @@ static void *allocPool(int mustSucceed)
         }
         return NULL;
     }
+
+#ifdef MADV_HUGEPAGE
+    /* explicit huge pages aren't available through posix_memalign, so both
+     * settings mean transparent huge pages */
+    if (ggggc_hugePages)
+        madvise(ret, GGGGC_POOL_BYTES, MADV_HUGEPAGE);
+#endif
+
     return ret;
 }
+
+/* return a free pool's memory, except for its header, to the OS */
+static void decommitPool(struct GGGGC_Pool *pool)
+{
+#ifdef MADV_DONTNEED
+    ggc_size_t page = pageSize();
+    madvise((unsigned char *) pool + page, GGGGC_POOL_BYTES - page, MADV_DONTNEED);
+#endif
+}
+
+/* make a decommitted pool usable again (untouched pages come back on demand) */
+static void recommitPool(struct GGGGC_Pool *pool)
+{
+    (void) pool;
+}
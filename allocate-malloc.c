@@ -51,3 +51,14 @@ static void *allocPool(int mustSucceed)
 
     return ret;
 }
+
+/* malloc'd space can't be partially returned to the OS */
+static void decommitPool(struct GGGGC_Pool *pool)
+{
+    (void) pool;
+}
+
+static void recommitPool(struct GGGGC_Pool *pool)
+{
+    (void) pool;
+}
@@ -16,14 +16,34 @@
  * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
+/* set once any pool is backed by explicit huge pages, which can only be
+ * decommitted a whole huge page at a time */
+static int hugeTLB = 0;
+
 static void *allocPool(int mustSucceed)
 {
     unsigned char *space, *aspace;
     struct GGGGC_Pool *ret;
 
+    space = (unsigned char *) MAP_FAILED;
+
+#ifdef MAP_HUGETLB
+    if (ggggc_hugePages == GGGGC_HUGE_PAGES_EXPLICIT) {
+        space = mmap(NULL, GGGGC_POOL_BYTES*2, PROT_READ|PROT_WRITE,
+                     MAP_PRIVATE|MAP_ANON|MAP_HUGETLB, -1, 0);
+        if (space == MAP_FAILED) {
+            /* none reserved, so don't keep asking */
+            ggggc_hugePages = GGGGC_HUGE_PAGES_TRANSPARENT;
+        } else {
+            hugeTLB = 1;
+        }
+    }
+#endif
+
     /* allocate enough space that we can align it later */
-    space = mmap(NULL, GGGGC_POOL_BYTES*2, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANON, -1, 0);
-    if (space == NULL) {
+    if (space == MAP_FAILED)
+        space = mmap(NULL, GGGGC_POOL_BYTES*2, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANON, -1, 0);
+    if (space == MAP_FAILED) {
         if (mustSucceed) {
             perror("mmap");
             abort();
@@ -40,5 +60,25 @@ static void *allocPool(int mustSucceed)
         munmap(space, aspace - space);
     munmap(aspace + GGGGC_POOL_BYTES, space + GGGGC_POOL_BYTES - aspace);
 
+#ifdef MADV_HUGEPAGE
+    if (ggggc_hugePages)
+        madvise(aspace, GGGGC_POOL_BYTES, MADV_HUGEPAGE);
+#endif
+
     return ret;
 }
+
+/* return a free pool's memory, except for its header, to the OS */
+static void decommitPool(struct GGGGC_Pool *pool)
+{
+#ifdef MADV_DONTNEED
+    ggc_size_t page = hugeTLB ? GGGGC_HUGE_PAGE_BYTES : pageSize();
+    madvise((unsigned char *) pool + page, GGGGC_POOL_BYTES - page, MADV_DONTNEED);
+#endif
+}
+
+/* make a decommitted pool usable again (untouched pages come back on demand) */
+static void recommitPool(struct GGGGC_Pool *pool)
+{
+    (void) pool;
+}
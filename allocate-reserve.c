@@ -0,0 +1,130 @@
+/*
+ * Allocation functions (reserved address space)
+ *
+ * Copyright (c) 2014, 2015 Gregor Richards
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION
+ * OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+/* The whole heap is reserved (but not committed) up front, and pools are
+ * committed from it in order, so the heap is one contiguous range */
+
+/* the end of the reservation */
+static unsigned char *heapEnd;
+
+/* set once any pool is backed by explicit huge pages, which can only be
+ * decommitted a whole huge page at a time */
+static int hugeTLB = 0;
+
+/* reserve the heap */
+static int reserveHeap(int mustSucceed)
+{
+    unsigned char *space, *aspace;
+
+    /* reserve enough space that we can align it */
+    space = mmap(NULL, GGGGC_HEAP_RESERVE + GGGGC_POOL_BYTES, PROT_NONE,
+                 MAP_PRIVATE|MAP_ANON|MAP_NORESERVE, -1, 0);
+    if (space == MAP_FAILED) {
+        if (mustSucceed) {
+            perror("mmap");
+            abort();
+        }
+        return 0;
+    }
+
+    /* align it */
+    aspace = (unsigned char *) GGGGC_POOL_OF(space + GGGGC_POOL_BYTES - 1);
+    if (aspace > space)
+        munmap(space, aspace - space);
+    munmap(aspace + GGGGC_HEAP_RESERVE, space + GGGGC_POOL_BYTES - aspace);
+
+    ggggc_heapBase = ggggc_heapTop = aspace;
+    heapEnd = aspace + GGGGC_HEAP_RESERVE;
+    return 1;
+}
+
+static void *allocPool(int mustSucceed)
+{
+    unsigned char *ret;
+
+    if (!ggggc_heapBase && !reserveHeap(mustSucceed))
+        return NULL;
+
+    if (ggggc_heapTop + GGGGC_POOL_BYTES > heapEnd) {
+        if (mustSucceed) {
+            fprintf(stderr, "GGGGC: Heap reservation exhausted\n");
+            abort();
+        }
+        return NULL;
+    }
+
+    ret = ggggc_heapTop;
+
+#ifdef MAP_HUGETLB
+    /* explicit huge pages are mapped over the pool's part of the reservation */
+    if (ggggc_hugePages == GGGGC_HUGE_PAGES_EXPLICIT) {
+        if (mmap(ret, GGGGC_POOL_BYTES, PROT_READ|PROT_WRITE,
+                 MAP_PRIVATE|MAP_ANON|MAP_FIXED|MAP_HUGETLB, -1, 0) ==
+            (void *) ret) {
+            hugeTLB = 1;
+            ggggc_heapTop += GGGGC_POOL_BYTES;
+            return ret;
+        }
+
+        /* none reserved, so don't keep asking, and since the failed mapping
+         * may have unmapped this part of the reservation, reserve it again */
+        ggggc_hugePages = GGGGC_HUGE_PAGES_TRANSPARENT;
+        if (mmap(ret, GGGGC_POOL_BYTES, PROT_NONE,
+                 MAP_PRIVATE|MAP_ANON|MAP_NORESERVE|MAP_FIXED, -1, 0) !=
+            (void *) ret) {
+            if (mustSucceed) {
+                perror("mmap");
+                abort();
+            }
+            return NULL;
+        }
+    }
+#endif
+
+    /* commit the next pool */
+    if (mprotect(ret, GGGGC_POOL_BYTES, PROT_READ|PROT_WRITE) != 0) {
+        if (mustSucceed) {
+            perror("mprotect");
+            abort();
+        }
+        return NULL;
+    }
+    ggggc_heapTop += GGGGC_POOL_BYTES;
+
+#ifdef MADV_HUGEPAGE
+    if (ggggc_hugePages)
+        madvise(ret, GGGGC_POOL_BYTES, MADV_HUGEPAGE);
+#endif
+
+    return ret;
+}
+
+/* return a free pool's memory, except for its header, to the OS */
+static void decommitPool(struct GGGGC_Pool *pool)
+{
+#ifdef MADV_DONTNEED
+    ggc_size_t page = hugeTLB ? GGGGC_HUGE_PAGE_BYTES : pageSize();
+    madvise((unsigned char *) pool + page, GGGGC_POOL_BYTES - page, MADV_DONTNEED);
+#endif
+}
+
+/* make a decommitted pool usable again (untouched pages come back on demand) */
+static void recommitPool(struct GGGGC_Pool *pool)
+{
+    (void) pool;
+}
@@ -43,3 +43,21 @@ static void *allocPool(int mustSucceed)
 
     return ret;
 }
+
+/* return a free pool's memory, except for its header, to the OS */
+static void decommitPool(struct GGGGC_Pool *pool)
+{
+    ggc_size_t page = pageSize();
+    VirtualFree((unsigned char *) pool + page, GGGGC_POOL_BYTES - page, MEM_DECOMMIT);
+}
+
+/* make a decommitted pool usable again */
+static void recommitPool(struct GGGGC_Pool *pool)
+{
+    ggc_size_t page = pageSize();
+    if (!VirtualAlloc((unsigned char *) pool + page, GGGGC_POOL_BYTES - page,
+                      MEM_COMMIT, PAGE_READWRITE)) {
+        perror("VirtualAlloc");
+        abort();
+    }
+}
@@ -33,6 +33,7 @@
 #endif
 
 #include <errno.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
@@ -53,11 +54,38 @@
 extern "C" {
 #endif
 
+/* the OS page size */
+static ggc_size_t pageSize()
+{
+    static ggc_size_t size = 0;
+    if (!size) {
+#if defined(_WIN32)
+        SYSTEM_INFO info;
+        GetSystemInfo(&info);
+        size = info.dwPageSize;
+#elif _POSIX_VERSION
+        size = sysconf(_SC_PAGESIZE);
+#else
+        size = 4096;
+#endif
+    }
+    return size;
+}
+
 /* figure out which allocator to use */
 #if defined(GGGGC_USE_MALLOC)
 #define GGGGC_ALLOCATOR_MALLOC 1
 #include "allocate-malloc.c"
 
+#elif defined(GGGGC_USE_MMAP) && defined(MAP_ANON)
+#define GGGGC_ALLOCATOR_MMAP 1
+#include "allocate-mmap.c"
+
+#elif !defined(GGGGC_NO_RESERVE) && defined(MAP_ANON) && \
+      defined(MAP_NORESERVE) && SIZE_MAX > 0xFFFFFFFFu
+#define GGGGC_ALLOCATOR_RESERVE 1
+#include "allocate-reserve.c"
+
 #elif _POSIX_ADVISORY_INFO >= 200112L
 #define GGGGC_ALLOCATOR_POSIX_MEMALIGN 1
 #include "allocate-malign.c"
@@ -85,6 +113,7 @@ static struct GGGGC_Pool *freePoolsHead, *freePoolsTail;
 static struct GGGGC_Pool *newPool(int mustSucceed)
 {
     struct GGGGC_Pool *ret;
+    int reused = 0;
 
     ret = NULL;
 
@@ -95,52 +124,135 @@ static struct GGGGC_Pool *newPool(int mustSucceed)
             freePoolsHead = freePoolsHead->next;
             if (!freePoolsHead) freePoolsTail = NULL;
         }
+        reused = 1;
+        if (ret->decommitted) {
+            recommitPool(ret);
+            ggggc_stats.decommittedPoolCount--;
+        } else {
+            ggggc_stats.freePoolCount--;
+        }
     }
 
     /* otherwise, allocate one */
     if (!ret) ret = (struct GGGGC_Pool *) allocPool(mustSucceed);
 
     if (!ret) return NULL;
+    GGGGC_TRACE_INSTANT("newPool", "reused", reused);
+    GGGGC_PROBE2(new__pool, ret, reused);
 
     /* set it up */
     ret->next = NULL;
     ret->free = ret->start;
     ret->end = (ggc_size_t *) ((unsigned char *) ret + GGGGC_POOL_BYTES);
     ret->freeList = NULL;
+    ret->freeWords = ret->largestRun = ret->runs = 0;
+    memset(ret->sizeClasses, 0, sizeof(ret->sizeClasses));
+    ret->decommitted = 0;
 
     return ret;
 }
 
-/* heuristically expand a generation if it has too many survivors */
-void ggggc_expandGeneration(struct GGGGC_Pool *pool)
+/* expand a generation to at least the given number of pools */
+void ggggc_expandGeneration(struct GGGGC_Pool *pool, ggc_size_t pools)
 {
-    ggc_size_t space, survivors, poolCt;
+    ggc_size_t poolCt;
 
     if (!pool) return;
 
-    /* first figure out how much space was used */
-    space = 0;
-    survivors = 0;
-    poolCt = 0;
-    while (1) {
-        space += pool->end - pool->start;
-        survivors += pool->survivors;
-        pool->survivors = 0;
+    /* first figure out how many pools there are */
+    poolCt = 1;
+    while (pool->next) {
+        pool = pool->next;
         poolCt++;
-        if (!pool->next) break;
+    }
+
+    /* then allocate more */
+    for (; poolCt < pools; poolCt++) {
+        pool->next = newPool(0);
         pool = pool->next;
+        if (!pool) break;
+        ggggc_poolCount++;
     }
+}
 
-    /* now decide if it's too much */
-    if (survivors > space/2) {
-        /* allocate more */
-        ggc_size_t i;
-        for (i = 0; i < poolCt; i++) {
-            pool->next = newPool(0);
-            pool = pool->next;
-            if (!pool) break;
+/* set the heap policy, in bytes */
+void ggggc_setHeapPolicy(ggc_size_t minBytes, ggc_size_t maxBytes, unsigned growthPercent)
+{
+    ggggc_heapMin = minBytes / sizeof(ggc_size_t);
+    ggggc_heapMax = maxBytes / sizeof(ggc_size_t);
+    ggggc_growthPercent = growthPercent;
+    ggggc_resizeHeap(ggggc_stats.liveBytes / sizeof(ggc_size_t));
+}
+
+/* set the pacer's targets */
+void ggggc_setPacer(ggc_size_t maxPauseUs, unsigned cpuPercent)
+{
+    ggggc_pauseTarget = maxPauseUs * 1000;
+    ggggc_gcCpuPercent = cpuPercent;
+    ggggc_resizeHeap(ggggc_stats.liveBytes / sizeof(ggc_size_t));
+}
+
+/* after a collection, decide how much may be allocated before the next one,
+ * and grow the heap to make room for it */
+void ggggc_resizeHeap(ggc_size_t liveWords)
+{
+    ggc_size_t target, pools;
+
+    /* GOGC-style: the heap may grow by a fixed fraction of what's live */
+    target = liveWords + liveWords / 100 * ggggc_growthPercent;
+    if (target < ggggc_heapMin) target = ggggc_heapMin;
+    if (ggggc_heapMax && target > ggggc_heapMax) target = ggggc_heapMax;
+
+    ggggc_stats.pacedBy = GGGGC_PACED_GROWTH;
+
+    /* collecting too often? Then give the mutator more to allocate into. A
+     * collection costs marking what's live plus sweeping the heap, and the
+     * mutator needs (100-cpu)/cpu times that long between collections. */
+    if (ggggc_gcCpuPercent && ggggc_gcCpuPercent < 100 && ggggc_allocRate > 0 &&
+        ggggc_markRate > 0 && ggggc_sweepRate > 0) {
+        double cost = liveWords / ggggc_markRate + target / ggggc_sweepRate;
+        double budget = cost * (100 - ggggc_gcCpuPercent) / ggggc_gcCpuPercent *
+            ggggc_allocRate;
+        if (liveWords + budget > target) {
+            target = liveWords + (ggc_size_t) budget;
+            if (ggggc_heapMax && target > ggggc_heapMax) target = ggggc_heapMax;
+            ggggc_stats.pacedBy = GGGGC_PACED_CPU;
         }
     }
+
+    /* but the pause target wins: the sweep is what grows with the heap */
+    if (ggggc_pauseTarget && ggggc_markRate > 0 && ggggc_sweepRate > 0) {
+        double markTime = liveWords / ggggc_markRate;
+        double maxHeap = (ggggc_pauseTarget - markTime) * ggggc_sweepRate;
+        if (markTime >= ggggc_pauseTarget) maxHeap = 0;
+        if (target > maxHeap) {
+            target = (ggc_size_t) maxHeap;
+            ggggc_stats.pacedBy = GGGGC_PACED_PAUSE;
+        }
+    }
+
+    /* but we always need some room to allocate into */
+    if (target < liveWords + GGGGC_WORDS_PER_POOL / 2)
+        target = liveWords + GGGGC_WORDS_PER_POOL / 2;
+
+    /* and nothing grows past the hard limit */
+    if (ggggc_heapLimit && target > ggggc_heapLimit)
+        target = (ggggc_heapLimit > liveWords) ? ggggc_heapLimit : liveWords + 1;
+
+    if (ggggc_markRate > 0 && ggggc_sweepRate > 0)
+        ggggc_stats.predictedPauseNs = (ggc_size_t)
+            (liveWords / ggggc_markRate + target / ggggc_sweepRate);
+
+    ggggc_collectThreshold = target - liveWords;
+    if (ggggc_allocatedWords >= ggggc_collectThreshold)
+        ggggc_forceCollect = 1;
+    ggggc_stats.heapTargetBytes = target * sizeof(ggc_size_t);
+
+    /* pre-grow the pools to match, if we've got any yet */
+    pools = (target + GGGGC_WORDS_PER_POOL - 1) / GGGGC_WORDS_PER_POOL;
+    if (ggggc_heapLimit && pools > ggggc_heapLimit / GGGGC_WORDS_PER_POOL)
+        pools = ggggc_heapLimit / GGGGC_WORDS_PER_POOL;
+    ggggc_expandGeneration(ggggc_poolList, pools);
 }
 
 /* free a generation (used when a thread exits) */
@@ -152,44 +264,169 @@ void ggggc_freeGeneration(struct GGGGC_Pool *pool)
     } else {
         freePoolsHead = pool;
     }
-    while (pool->next) pool = pool->next;
+    while (1) {
+        pool->freedAt = ggggc_stats.collections;
+        pool->decommitted = 0;
+        ggggc_stats.freePoolCount++;
+        if (!pool->next) break;
+        pool = pool->next;
+    }
     freePoolsTail = pool;
 }
 
+/* return free pools which have been idle long enough to the OS */
+void ggggc_decommitFreePools()
+{
+    struct GGGGC_Pool *pool;
+    ggc_size_t retained = 0, rss = 0, decommitted = 0;
+
+    for (pool = freePoolsHead; pool; pool = pool->next) {
+        if (pool->decommitted) continue;
+
+        /* keep a floor of free pools ready to go */
+        if (retained < ggggc_retainedPools) {
+            retained++;
+            continue;
+        }
+
+        if (ggggc_stats.collections - pool->freedAt < ggggc_decommitDelay)
+            continue;
+
+        if (!decommitted) rss = ggggc_rss();
+        decommitPool(pool);
+        pool->decommitted = 1;
+        decommitted++;
+    }
+
+    if (decommitted) {
+        ggggc_stats.freePoolCount -= decommitted;
+        ggggc_stats.decommittedPoolCount += decommitted;
+        ggggc_stats.decommittedBytes += decommitted * GGGGC_POOL_BYTES;
+        ggggc_stats.rssBeforeDecommit = rss;
+        ggggc_stats.rssAfterDecommit = ggggc_rss();
+    }
+}
+
+/* the resident set size of the process */
+ggc_size_t ggggc_rss()
+{
+#if defined(__linux__)
+    FILE *statm;
+    unsigned long size, resident;
+    int got;
+
+    statm = fopen("/proc/self/statm", "r");
+    if (!statm) return 0;
+    got = fscanf(statm, "%lu %lu", &size, &resident);
+    fclose(statm);
+    if (got != 2) return 0;
+    return (ggc_size_t) resident * pageSize();
+#else
+    return 0;
+#endif
+}
+
+/* get a snapshot of the collector's statistics */
+void ggggc_getStats(struct GGGGC_Stats *stats)
+{
+    extern ggc_size_t ggggc_poolCount;
+    *stats = ggggc_stats;
+    stats->poolCount = ggggc_poolCount;
+    stats->allocatedBytes += ggggc_allocatedWords * sizeof(ggc_size_t);
+}
+
 /* Function when allocating an object to zero out all
    it's internal space past the header */
 void ggggc_zero_object(struct GGGGC_Header *hdr)
 {
-    ggc_size_t size = hdr->descriptor__ptr->size - GGGGC_WORD_SIZEOF(*hdr);
-    ggc_size_t i = 0;
-    ggc_size_t * iter = ((ggc_size_t *) hdr) + 1;
-    //printf("Zeroing object at %lx starting at %lx\r\n", (long unsigned int) hdr, (long unsigned int) iter);
-    while (i < size) {
-        iter[0] = 0;
-        //printf("For object %lx wiping %lx\r\n", (long unsigned int) hdr, (long unsigned int) iter);
-        iter = iter + 1;
-        i++;
+    ggc_size_t size = GGGGC_DESCRIPTOR_OF(hdr)->size - GGGGC_WORD_SIZEOF(*hdr);
+    memset(hdr + 1, 0, size * sizeof(ggc_size_t));
+}
+
+static void *allocate(struct GGGGC_Descriptor *descriptor, int mustSucceed);
+
+/* set while an allocation is being retried after an emergency collection */
+static int emergency = 0;
+
+/* an allocation which must succeed couldn't */
+static void outOfMemoryAbort(struct GGGGC_Descriptor *descriptor)
+{
+    fprintf(stderr, "GGGGC: out of memory allocating %lu bytes\n",
+        (unsigned long) (descriptor->size * sizeof(ggc_size_t)));
+    abort();
+}
+
+/* the heap can't grow: collect as hard as we can, asking the OOM handler to
+ * free what it can, until the allocation fits or nothing more can be done */
+static void *outOfMemory(struct GGGGC_Descriptor *descriptor, int mustSucceed)
+{
+    void *ret = NULL;
+
+    /* already retrying (or the OOM handler is allocating), so the emergency
+     * collection wasn't enough */
+    if (emergency) {
+        if (mustSucceed) outOfMemoryAbort(descriptor);
+        return NULL;
+    }
+
+    GGC_PUSH_1(descriptor);
+
+    GGGGC_TRACE_INSTANT("out of memory", "bytes",
+        descriptor->size * sizeof(ggc_size_t));
+
+    emergency = 1;
+    while (1) {
+        ggggc_stats.emergencyCollections++;
+        ggggc_collect();
+        ret = allocate(descriptor, 0);
+        if (ret) break;
+        if (!ggggc_oomHandler ||
+            !ggggc_oomHandler(descriptor->size * sizeof(ggc_size_t)))
+            break;
     }
-    return;
+    emergency = 0;
+
+    if (!ret && mustSucceed) outOfMemoryAbort(descriptor);
+
+    return ret;
 }
 
 /* allocate an object */
 void *ggggc_malloc(struct GGGGC_Descriptor *descriptor)
+{
+    return allocate(descriptor, 1);
+}
+
+/* allocate an object, returning NULL if the heap is exhausted */
+void *ggggc_tryMalloc(struct GGGGC_Descriptor *descriptor)
+{
+    return allocate(descriptor, 0);
+}
+
+/* set the function called when the heap is exhausted */
+void ggggc_setOOMHandler(int (*handler)(ggc_size_t bytes))
+{
+    ggggc_oomHandler = handler;
+}
+
+static void *allocate(struct GGGGC_Descriptor *descriptor, int mustSucceed)
 {
     /* Yield at allocation, if it decides to collect we have more space! */
     ggggc_yield();
     void* userPtr;
     struct GGGGC_Header header;
     extern ggc_size_t ggggc_poolCount;
-    extern int ggggc_forceCollect;
-    header.descriptor__ptr = descriptor;
+    header.descriptor__ptr = GGGGC_UNMARKED(descriptor);
     /* Check if curPool is set... if not we probably have no pools yet...
        and if we do have pools already we're in trouble cuz we lost our pointers
        to them so... EEP. */
     if (!ggggc_curPool) {
         ggggc_poolCount = 1;
         ggggc_forceCollect = 0;
+        /* the configuration decides how the first pool is allocated */
+        if (!ggggc_initialized) ggggc_init(NULL);
         ggggc_curPool = ggggc_poolList = newPool(1);
+        ggggc_resizeHeap(ggggc_stats.liveBytes / sizeof(ggc_size_t));
     }
     /* Check if there are any free objects if there are try to find a suitable one */
     int suitableFree = 0;
@@ -198,7 +435,7 @@ void *ggggc_malloc(struct GGGGC_Descriptor *descriptor)
         struct GGGGC_FreeObject *freeIter = ggggc_curPool->freeList;
         struct GGGGC_FreeObject *prevIter = NULL;
         while (freeIter && !suitableFree) {
-            if (freeIter->descriptor__ptr->size == descriptor->size) {
+            if (GGGGC_FREE_SIZE(freeIter) == descriptor->size) {
                 suitableFree = 1;
                 userPtr = freeIter;
                 //fprintf(stderr,"allocating to freeobject %lx\r\n", (long unsigned int) freeIter);
@@ -211,6 +448,12 @@ void *ggggc_malloc(struct GGGGC_Descriptor *descriptor)
             prevIter = freeIter;
             freeIter = freeIter->next;
         }
+        if (suitableFree) {
+            GGGGC_PROBE1(free__list__hit, descriptor->size);
+        } else {
+            GGGGC_TRACE_INSTANT("free list miss", "words", descriptor->size);
+            GGGGC_PROBE1(free__list__miss, descriptor->size);
+        }
     }
     /* If there are no suitable free objects allocate at the end of the pool */
     if (!suitableFree) {
@@ -219,15 +462,24 @@ void *ggggc_malloc(struct GGGGC_Descriptor *descriptor)
             /* If the object too big for our current pool get a new one */
             /* This should be changed to iterating through the pools later
                to check if there is a pool with enough space */
-            if (ggggc_curPool->next) {
+            struct GGGGC_Pool *next = ggggc_sweptNext(ggggc_curPool);
+            if (next) {
                 // if we're not on last pool let's go to the next pool before maknig new one
-                ggggc_curPool = ggggc_curPool->next;
+                ggggc_curPool = next;
                 //printf("recurisvely calling malloc...\r\n");
-                return ggggc_malloc(descriptor);
+                return allocate(descriptor, mustSucceed);
             }
-            struct GGGGC_Pool *temp = newPool(1);
-            // Force a collection when we need to allocate a new pool.
-            ggggc_forceCollect = 1;
+            // Past the hard limit, the heap can't grow at all.
+            if (ggggc_heapLimit &&
+                (ggggc_poolCount + 1) * GGGGC_WORDS_PER_POOL > ggggc_heapLimit)
+                return outOfMemory(descriptor, mustSucceed);
+            // Collections are triggered by how much we've allocated, so
+            // just grow, unless that takes us past the maximum heap size.
+            if (ggggc_heapMax &&
+                (ggggc_poolCount + 1) * GGGGC_WORDS_PER_POOL > ggggc_heapMax)
+                ggggc_forceCollect = 1;
+            struct GGGGC_Pool *temp = newPool(0);
+            if (!temp) return outOfMemory(descriptor, mustSucceed);
             ggggc_poolCount++;
             ggggc_curPool->next = temp;
             ggggc_curPool = temp;
@@ -237,34 +489,72 @@ void *ggggc_malloc(struct GGGGC_Descriptor *descriptor)
     }
     //printf("User ptr allocated at: %lx\r\n", (long unsigned int) userPtr);
     ((struct GGGGC_Header *) userPtr)[0] = header;
-    //ggggc_zero_object((struct GGGGC_Header*) userPtr);
+    ggggc_allocatedWords += descriptor->size;
+    ggggc_stats.allocatedObjects++;
+    if (ggggc_allocatedWords >= ggggc_collectThreshold)
+        ggggc_forceCollect = 1;
+    /* reused space still has stale pointers in it, which the tracer would
+     * follow before the mutator gets a chance to initialize them */
+    ggggc_zero_object((struct GGGGC_Header*) userPtr);
+    if (descriptor->size >= GGGGC_PROBE_LARGE_WORDS)
+        GGGGC_PROBE2(large__alloc, userPtr,
+            descriptor->size * sizeof(ggc_size_t));
+    /* and sample it, if this is where the profiler's countdown ends */
+    if (descriptor->size >= ggggc_profileLeft)
+        ggggc_profileSample(userPtr, descriptor);
+    else
+        ggggc_profileLeft -= descriptor->size;
     return userPtr;
 }
 
-struct GGGGC_Array {
-    struct GGGGC_Header header;
-    ggc_size_t length;
-};
-
 /* allocate a pointer array (size is in words) */
-void *ggggc_mallocPointerArray(ggc_size_t sz)
+static void *allocatePointerArray(ggc_size_t sz, int mustSucceed)
 {
     struct GGGGC_Descriptor *descriptor = ggggc_allocateDescriptorPA(sz + 1 + sizeof(struct GGGGC_Header)/sizeof(ggc_size_t));
-    struct GGGGC_Array *ret = (struct GGGGC_Array *) ggggc_malloc(descriptor);
-    ret->length = sz;
+    struct GGGGC_Array *ret;
+
+    /* nothing else refers to the descriptor until the array exists */
+    GGC_PUSH_1(descriptor);
+
+    ret = (struct GGGGC_Array *) allocate(descriptor, mustSucceed);
+    if (ret) ret->length = sz;
     return ret;
 }
 
+void *ggggc_mallocPointerArray(ggc_size_t sz)
+{
+    return allocatePointerArray(sz, 1);
+}
+
+void *ggggc_tryMallocPointerArray(ggc_size_t sz)
+{
+    return allocatePointerArray(sz, 0);
+}
+
 /* allocate a data array */
-void *ggggc_mallocDataArray(ggc_size_t nmemb, ggc_size_t size)
+static void *allocateDataArray(ggc_size_t nmemb, ggc_size_t size, int mustSucceed)
 {
     ggc_size_t sz = ((nmemb*size)+sizeof(ggc_size_t)-1)/sizeof(ggc_size_t);
     struct GGGGC_Descriptor *descriptor = ggggc_allocateDescriptorDA(sz + 1 + sizeof(struct GGGGC_Header)/sizeof(ggc_size_t));
-    struct GGGGC_Array *ret = (struct GGGGC_Array *) ggggc_malloc(descriptor);
-    ret->length = nmemb;
+    struct GGGGC_Array *ret;
+
+    GGC_PUSH_1(descriptor);
+
+    ret = (struct GGGGC_Array *) allocate(descriptor, mustSucceed);
+    if (ret) ret->length = nmemb;
     return ret;
 }
 
+void *ggggc_mallocDataArray(ggc_size_t nmemb, ggc_size_t size)
+{
+    return allocateDataArray(nmemb, size, 1);
+}
+
+void *ggggc_tryMallocDataArray(ggc_size_t nmemb, ggc_size_t size)
+{
+    return allocateDataArray(nmemb, size, 0);
+}
+
 /* allocate a descriptor-descriptor for a descriptor of the given size */
 struct GGGGC_Descriptor *ggggc_allocateDescriptorDescriptor(ggc_size_t size)
 {
@@ -286,6 +576,7 @@ struct GGGGC_Descriptor *ggggc_allocateDescriptorDescriptor(ggc_size_t size)
     /* now make a temporary descriptor to describe the descriptor descriptor */
     tmpDescriptor.header.descriptor__ptr = NULL;
     tmpDescriptor.size = ddSize;
+    tmpDescriptor.flags = 0;
     tmpDescriptor.pointers[0] = GGGGC_DESCRIPTOR_DESCRIPTION;
 
     /* allocate the descriptor descriptor */
@@ -293,6 +584,7 @@ struct GGGGC_Descriptor *ggggc_allocateDescriptorDescriptor(ggc_size_t size)
 
     /* make it correct */
     ret->size = size;
+    ret->flags = 0;
     ret->pointers[0] = GGGGC_DESCRIPTOR_DESCRIPTION;
 
     /* put it in the list */
@@ -301,7 +593,7 @@ struct GGGGC_Descriptor *ggggc_allocateDescriptorDescriptor(ggc_size_t size)
     GGC_GLOBALIZE();
 
     /* and give it a proper descriptor */
-    ret->header.descriptor__ptr = ggggc_allocateDescriptorDescriptor(ddSize);
+    ret->header.descriptor__ptr = GGGGC_UNMARKED(ggggc_allocateDescriptorDescriptor(ddSize));
     return ret;
 }
 
@@ -314,30 +606,49 @@ struct GGGGC_Descriptor *ggggc_allocateDescriptor(ggc_size_t size, ggc_size_t po
     return ggggc_allocateDescriptorL(size, pointersA);
 }
 
+/* allocate a descriptor with room for the given number of pointer words */
+static struct GGGGC_Descriptor *newDescriptor(ggc_size_t size, ggc_size_t dPWords)
+{
+    struct GGGGC_Descriptor *dd, *ret;
+    ggc_size_t dSize;
+
+    dSize = GGGGC_WORD_SIZEOF(struct GGGGC_Descriptor) + dPWords;
+
+    /* get a descriptor-descriptor for the descriptor we're about to allocate */
+    dd = ggggc_allocateDescriptorDescriptor(dSize);
+
+    /* use that to allocate the descriptor */
+    ret = (struct GGGGC_Descriptor *) ggggc_malloc(dd);
+    ret->size = size;
+    ret->flags = 0;
+
+    return ret;
+}
+
 /* descriptor allocator when more than one word is required to describe the
  * pointers */
 struct GGGGC_Descriptor *ggggc_allocateDescriptorL(ggc_size_t size, const ggc_size_t *pointers)
 {
-    struct GGGGC_Descriptor *dd, *ret;
-    ggc_size_t dPWords, dSize;
+    struct GGGGC_Descriptor *ret;
+    ggc_size_t dPWords;
 
     /* the size of the descriptor */
     if (pointers)
         dPWords = GGGGC_DESCRIPTOR_WORDS_REQ(size);
     else
         dPWords = 1;
-    dSize = GGGGC_WORD_SIZEOF(struct GGGGC_Descriptor) + dPWords;
 
-    /* get a descriptor-descriptor for the descriptor we're about to allocate */
-    dd = ggggc_allocateDescriptorDescriptor(dSize);
+    ret = newDescriptor(size, dPWords);
 
-    /* use that to allocate the descriptor */
-    ret = (struct GGGGC_Descriptor *) ggggc_malloc(dd);
-    ret->size = size;
     /* and set it up */
     if (pointers) {
         memcpy(ret->pointers, pointers, sizeof(ggc_size_t) * dPWords);
         ret->pointers[0] |= 1; /* first word is always the descriptor pointer */
+
+        /* nothing past the end of the object may be described as a pointer */
+        if (size % GGGGC_BITS_PER_WORD)
+            ret->pointers[dPWords-1] &=
+                ((ggc_size_t) 1 << (size % GGGGC_BITS_PER_WORD)) - 1;
     } else {
         ret->pointers[0] = 0;
     }
@@ -348,19 +659,15 @@ struct GGGGC_Descriptor *ggggc_allocateDescriptorL(ggc_size_t size, const ggc_si
 /* descriptor allocator for pointer arrays */
 struct GGGGC_Descriptor *ggggc_allocateDescriptorPA(ggc_size_t size)
 {
-    ggc_size_t *pointers;
-    ggc_size_t dPWords, i;
-
-    /* fill our pointer-words with 1s */
-    dPWords = GGGGC_DESCRIPTOR_WORDS_REQ(size);
-    pointers = (ggc_size_t *) alloca(sizeof(ggc_size_t) * dPWords);
-    for (i = 0; i < dPWords; i++) pointers[i] = (ggc_size_t) -1;
+    struct GGGGC_Descriptor *ret;
 
-    /* get rid of non-pointers */
-    pointers[0] &= ~0x4;
+    /* the collector scans pointer arrays by their flag, so no matter how long
+     * the array is, one bitmap word (for the descriptor pointer) suffices */
+    ret = newDescriptor(size, 1);
+    ret->flags = GGGGC_DESCRIPTOR_FLAG_POINTER_ARRAY;
+    ret->pointers[0] = 1;
 
-    /* and allocate */
-    return ggggc_allocateDescriptorL(size, pointers);
+    return ret;
 }
 
 /* descriptor allocator for data arrays */
@@ -373,12 +680,21 @@ struct GGGGC_Descriptor *ggggc_allocateDescriptorDA(ggc_size_t size)
 /* allocate a descriptor from a descriptor slot */
 struct GGGGC_Descriptor *ggggc_allocateDescriptorSlot(struct GGGGC_DescriptorSlot *slot)
 {
+    ggc_size_t *pointers;
+    ggc_size_t pWords, i;
+
     if (slot->descriptor) return slot->descriptor;
     if (slot->descriptor) {
         return slot->descriptor;
     }
 
-    slot->descriptor = ggggc_allocateDescriptor(slot->size, slot->pointers);
+    /* get the full pointer bitmap from the slot */
+    pWords = GGGGC_DESCRIPTOR_WORDS_REQ(slot->size);
+    pointers = (ggc_size_t *) alloca(sizeof(ggc_size_t) * pWords);
+    for (i = 0; i < pWords; i++) pointers[i] = slot->pointers(i);
+
+    slot->descriptor = ggggc_allocateDescriptorL(slot->size, pointers);
+    if (slot->name) ggggc_nameSlot(slot);
 
     /* make the slot descriptor a root */
     GGC_PUSH_1(slot->descriptor);
@@ -393,6 +709,11 @@ void *ggggc_mallocSlot(struct GGGGC_DescriptorSlot *slot)
     return ggggc_malloc(ggggc_allocateDescriptorSlot(slot));
 }
 
+void *ggggc_tryMallocSlot(struct GGGGC_DescriptorSlot *slot)
+{
+    return ggggc_tryMalloc(ggggc_allocateDescriptorSlot(slot));
+}
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,264 @@
+/*
+ * Live heap census by type
+ *
+ * Copyright (c) 2014, 2015 Gregor Richards
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION
+ * OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+
+/* for standards info */
+#if defined(unix) || defined(__unix) || defined(__unix__) || \
+    (defined(__APPLE__) && defined(__MACH__))
+#include <unistd.h>
+#endif
+
+#include "ggggc/gc.h"
+#include "ggggc-internals.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* the names of types named by GGC_END_TYPE, indexed by the number stored in
+ * their descriptors' flags */
+static const char **names;
+static ggc_size_t namesSize, namesUsed;
+
+/* what's being counted. Named types are counted by descriptor, everything
+ * else by kind, since e.g. every array has its own descriptor. */
+#define GGGGC_CENSUS_POINTER_ARRAYS ((struct GGGGC_Descriptor *) 1)
+#define GGGGC_CENSUS_DATA_ARRAYS    ((struct GGGGC_Descriptor *) 2)
+#define GGGGC_CENSUS_UNNAMED        ((struct GGGGC_Descriptor *) 3)
+struct GGGGC_CensusCount {
+    struct GGGGC_Descriptor *descriptor;
+    ggc_size_t objects, words;
+};
+
+int ggggc_censusActive;
+volatile sig_atomic_t ggggc_censusRequested;
+
+/* the census in progress, as an open-addressed hash table */
+static struct GGGGC_CensusCount *counts;
+static ggc_size_t countsSize, countsUsed;
+
+/* and the last one finished, sorted by size */
+static struct GGGGC_CensusEntry *lastCensus;
+static ggc_size_t lastCensusSize;
+
+/* remember the name of a type */
+void ggggc_nameSlot(struct GGGGC_DescriptorSlot *slot)
+{
+    if (namesUsed == namesSize) {
+        namesSize = namesSize ? namesSize * 2 : 64;
+        names = (const char **) realloc(names, namesSize * sizeof(char *));
+        if (!names) {
+            perror("realloc");
+            abort();
+        }
+    }
+    names[namesUsed] = slot->name;
+    slot->descriptor->flags |= GGGGC_DESCRIPTOR_FLAG_NAMED |
+        (namesUsed++ << GGGGC_DESCRIPTOR_NAME_SHIFT);
+}
+
+static const char *nameOf(struct GGGGC_Descriptor *descriptor)
+{
+    if (descriptor == GGGGC_CENSUS_POINTER_ARRAYS) return "(pointer arrays)";
+    if (descriptor == GGGGC_CENSUS_DATA_ARRAYS) return "(data arrays)";
+    if (descriptor == GGGGC_CENSUS_UNNAMED)
+        return "(descriptors and unnamed types)";
+    return names[descriptor->flags >> GGGGC_DESCRIPTOR_NAME_SHIFT];
+}
+
+/* named types are counted by descriptor, everything else by kind */
+static struct GGGGC_Descriptor *kindOf(struct GGGGC_Descriptor *descriptor)
+{
+    if (descriptor->flags & GGGGC_DESCRIPTOR_FLAG_NAMED) return descriptor;
+    if (descriptor->flags & GGGGC_DESCRIPTOR_FLAG_POINTER_ARRAY)
+        return GGGGC_CENSUS_POINTER_ARRAYS;
+    if (!(descriptor->pointers[0] & 1)) return GGGGC_CENSUS_DATA_ARRAYS;
+    return GGGGC_CENSUS_UNNAMED;
+}
+
+/* the name the census gives objects with this descriptor */
+const char *ggggc_descriptorName(struct GGGGC_Descriptor *descriptor)
+{
+    return nameOf(kindOf(descriptor));
+}
+
+static ggc_size_t hashOf(struct GGGGC_Descriptor *descriptor)
+{
+    ggc_size_t h = (ggc_size_t) descriptor;
+    h ^= h >> 17;
+    h *= (ggc_size_t) 0x9E3779B97F4A7C15ULL;
+    return h ^ (h >> 29);
+}
+
+static struct GGGGC_CensusCount *countFor(struct GGGGC_Descriptor *descriptor)
+{
+    ggc_size_t i = hashOf(descriptor) & (countsSize - 1);
+    while (counts[i].descriptor && counts[i].descriptor != descriptor)
+        i = (i + 1) & (countsSize - 1);
+    return &counts[i];
+}
+
+static void growCounts(ggc_size_t size)
+{
+    struct GGGGC_CensusCount *old = counts;
+    ggc_size_t oldSize = countsSize, i;
+
+    counts = (struct GGGGC_CensusCount *)
+        calloc(size, sizeof(struct GGGGC_CensusCount));
+    if (!counts) {
+        perror("calloc");
+        abort();
+    }
+    countsSize = size;
+
+    for (i = 0; i < oldSize; i++)
+        if (old[i].descriptor) *countFor(old[i].descriptor) = old[i];
+    free(old);
+}
+
+/* start counting with this collection's sweep */
+void ggggc_censusStart()
+{
+    if (!counts) growCounts(64);
+    memset(counts, 0, countsSize * sizeof(struct GGGGC_CensusCount));
+    countsUsed = 0;
+    ggggc_censusActive = 1;
+}
+
+/* count a live object */
+void ggggc_censusCount(struct GGGGC_Descriptor *descriptor, ggc_size_t words)
+{
+    struct GGGGC_CensusCount *count;
+
+    descriptor = kindOf(descriptor);
+    count = countFor(descriptor);
+    if (!count->descriptor) {
+        if ((countsUsed + 1) * 2 > countsSize) {
+            growCounts(countsSize * 2);
+            count = countFor(descriptor);
+        }
+        count->descriptor = descriptor;
+        countsUsed++;
+    }
+    count->objects++;
+    count->words += words;
+}
+
+static int compareEntries(const void *l, const void *r)
+{
+    const struct GGGGC_CensusEntry *le = (const struct GGGGC_CensusEntry *) l;
+    const struct GGGGC_CensusEntry *re = (const struct GGGGC_CensusEntry *) r;
+    if (le->bytes != re->bytes) return (le->bytes < re->bytes) ? 1 : -1;
+    return strcmp(le->name, re->name);
+}
+
+/* the sweep is done, so the census is too */
+void ggggc_censusFinish()
+{
+    ggc_size_t i, j;
+
+    ggggc_censusActive = 0;
+
+    free(lastCensus);
+    lastCensus = (struct GGGGC_CensusEntry *)
+        malloc((countsUsed + 1) * sizeof(struct GGGGC_CensusEntry));
+    if (!lastCensus) {
+        perror("malloc");
+        abort();
+    }
+
+    for (i = j = 0; i < countsSize; i++) {
+        if (!counts[i].descriptor) continue;
+        lastCensus[j].name = nameOf(counts[i].descriptor);
+        lastCensus[j].objects = counts[i].objects;
+        lastCensus[j].bytes = counts[i].words * sizeof(ggc_size_t);
+        j++;
+    }
+    lastCensusSize = j;
+    qsort(lastCensus, lastCensusSize, sizeof(struct GGGGC_CensusEntry),
+        compareEntries);
+
+    /* if a signal asked for it, it wants to see it */
+    if (ggggc_censusRequested) {
+        ggggc_censusRequested = 0;
+        ggggc_reportCensus();
+    }
+}
+
+/* take a census */
+ggc_size_t ggggc_census(struct GGGGC_CensusEntry *entries, ggc_size_t max)
+{
+    ggggc_censusRequested = 0;
+    ggggc_sweep();
+    ggggc_censusStart();
+    ggggc_collect();
+
+    if (max > lastCensusSize) max = lastCensusSize;
+    memcpy(entries, lastCensus, max * sizeof(struct GGGGC_CensusEntry));
+    return lastCensusSize;
+}
+
+/* print the last census to stderr */
+void ggggc_reportCensus()
+{
+    ggc_size_t i, objects = 0, bytes = 0;
+
+    fprintf(stderr, "GGGGC: live heap census:\n"
+                    "GGGGC: %12s %14s  %s\n", "objects", "bytes", "type");
+    for (i = 0; i < lastCensusSize; i++) {
+        fprintf(stderr, "GGGGC: %12lu %14lu  %s\n",
+            (unsigned long) lastCensus[i].objects,
+            (unsigned long) lastCensus[i].bytes,
+            lastCensus[i].name);
+        objects += lastCensus[i].objects;
+        bytes += lastCensus[i].bytes;
+    }
+    fprintf(stderr, "GGGGC: %12lu %14lu  total\n",
+        (unsigned long) objects, (unsigned long) bytes);
+}
+
+/* a census was asked for from outside, so take one at the next opportunity
+ * (ggggc_yield collects when it sees the request) */
+static void censusSignal(int signum)
+{
+    (void) signum;
+    ggggc_censusRequested = 1;
+}
+
+void ggggc_censusOnSignal(int signum)
+{
+#if _POSIX_VERSION
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = censusSignal;
+    sigemptyset(&sa.sa_mask);
+    sa.sa_flags = SA_RESTART;
+    sigaction(signum, &sa, NULL);
+#else
+    signal(signum, censusSignal);
+#endif
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -20,6 +20,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/types.h>
+#include <time.h>
 
 #include "ggggc/gc.h"
 #include "ggggc-internals.h"
@@ -28,77 +29,89 @@
 extern "C" {
 #endif
 
-struct StackLL 
-{
-    void *data;
-    struct StackLL *next;
-};
+/* the number of pointer array slots scanned before the rest of the array is
+ * put back on the mark stack */
+#ifndef GGGGC_MARK_CHUNK_WORDS
+#define GGGGC_MARK_CHUNK_WORDS 4096
+#endif
 
-struct StackLL * markStack;
+/* the number of objects popped from the mark stack and prefetched before we
+ * actually look at them (0 disables prefetching) */
+#ifndef GGGGC_PREFETCH_DEPTH
+#define GGGGC_PREFETCH_DEPTH 4
+#endif
 
-void StackLL_Init()
-{
-    markStack = (struct StackLL *)malloc(sizeof(struct StackLL));
-    markStack->data = NULL;
-    markStack->next = NULL;
-}
+#if defined(__GNUC__) && !defined(GGGGC_NO_GNUC_FEATURES)
+#define GGGGC_PREFETCH(x) __builtin_prefetch((x), 1) /* we'll write the mark */
+#else
+#define GGGGC_PREFETCH(x) do {} while(0)
+#endif
 
-void StackLL_Push(void *x)
-{
-    struct StackLL *new = (struct StackLL *)malloc(sizeof(struct StackLL));
-    new->data = x;
-    new->next = markStack;
-    markStack = new;
-}
+/* mark stack entries are either whole objects still to be marked (from == 0),
+ * or already-marked pointer arrays with slots left to scan from from */
+struct GGGGC_MarkEntry {
+    void *obj;
+    ggc_size_t from;
+};
+
+/* the mark stack, kept between collections */
+static struct GGGGC_MarkEntry *markStack;
+static ggc_size_t markStackTop, markStackSize;
 
-void * StackLL_Pop()
+static void markStackGrow()
 {
-    void * x = markStack->data;
-    struct StackLL *old = markStack;
-    if (x) {
-        markStack = markStack->next;
-        free(old);
+    markStackSize = markStackSize ? markStackSize * 2 : 1024;
+    markStack = (struct GGGGC_MarkEntry *)
+        realloc(markStack, markStackSize * sizeof(struct GGGGC_MarkEntry));
+    if (!markStack) {
+        perror("realloc");
+        abort();
     }
-    return x;
 }
 
-void StackLL_Clean()
+/* while ggggc_markParents, the object whose pointers are being pushed (or
+ * the pointer stack frame, tagged with its low bit), so that whatever first
+ * reaches each object can be remembered */
+static void *markParent;
+
+static inline void markStackPush(void *obj, ggc_size_t from)
 {
-    while(markStack->next) {
-        StackLL_Pop();
-    }
-    free(markStack);
+    if (markStackTop == markStackSize) markStackGrow();
+    if (ggggc_markParents && !from) ggggc_recordParent(obj, markParent);
+    markStack[markStackTop].obj = obj;
+    markStack[markStackTop].from = from;
+    markStackTop++;
 }
 
-extern int ggggc_forceCollect;
 
 long unsigned int ggggc_isMarked(void * x)
 {  
-    return (long unsigned int) ((struct GGGGC_Header *) x)->descriptor__ptr & 1l;
+    return ((ggc_size_t) ((struct GGGGC_Header *) x)->descriptor__ptr & 1) == ggggc_markEpoch;
 }
 
 void ggggc_markObject(void *x)
 {
     struct GGGGC_Header *header = (struct GGGGC_Header *) x;
     header->descriptor__ptr = (struct GGGGC_Descriptor *) 
-                              ((long unsigned int) header->descriptor__ptr | 1l );
+                              ((ggc_size_t) GGGGC_DESCRIPTOR_OF(header) | ggggc_markEpoch);
 }
 void ggggc_unmarkObject(void *x)
 {
     struct GGGGC_Header *header = (struct GGGGC_Header *) x;
-    /* probably shouldn't hardcode constant for max long -1 but oh welllllll */
-    header->descriptor__ptr = (struct GGGGC_Descriptor *) 
-                              ((long unsigned int) header->descriptor__ptr & 0xFFFFFFFFFFFFFFFE );
+    header->descriptor__ptr = GGGGC_UNMARKED(GGGGC_DESCRIPTOR_OF(header));
 }
 
 void * ggggc_cleanMark(void *x)
 {
-   struct GGGGC_Header * header = (struct GGGGC_Header *) x;
-   return (struct GGGGC_Descriptor *) ((long unsigned int) header->descriptor__ptr & 0xFFFFFFFFFFFFFFFE );
+   return GGGGC_DESCRIPTOR_OF(x);
 }
 
 
-void ggggc_mark()
+/* what the mark phase reached, for the statistics */
+static ggc_size_t markedObjects, markedWords;
+
+/* push every root onto the mark stack */
+static void scanRoots()
 {
     struct GGGGC_PointerStack *stack_iter;
     int x = 0;
@@ -107,17 +120,27 @@ void ggggc_mark()
         stack_iter = x == 0 ? ggggc_pointerStack : ggggc_pointerStackGlobals;
         while(stack_iter) {
             struct GGGGC_Header *** ptrptr = (struct GGGGC_Header ***) stack_iter->pointers;
-            if (**ptrptr) {
-                /* Here header is the pointer to the header of the object we're currently looking at
-                   the reference in the stack for (given by stack_iter), so we can mark it by
-                   updating header->descriptor_ptr */
-                struct GGGGC_Header *header= **ptrptr;
-                /* Check if this object is already marked, the first object off the stack never will be,
-                   but after recursing down the first one future ones could be */
-                if (!ggggc_isMarked((void*) header)) {
-                    //fprintf(stderr,"First found root %lx\r\n", (long unsigned int) header);
-                    StackLL_Push((void *) header);
-                    ggggc_markHelper();
+            ggc_size_t i;
+            markParent = (void *) ((ggc_size_t) stack_iter | 1);
+            /* Every pointer in this frame is a root, not just the first */
+            for (i = 0; i < stack_iter->size; i++, ptrptr++) {
+                if (**ptrptr) {
+                    /* Here header is the pointer to the header of the object we're currently looking at
+                       the reference in the stack for (given by stack_iter), so we can mark it by
+                       updating header->descriptor_ptr */
+                    struct GGGGC_Header *header= **ptrptr;
+#ifdef GGGGC_DEBUG_MEMORY_CORRUPTION
+                    if (ggggc_heapBase && !GGGGC_IN_HEAP(header)) {
+                        fprintf(stderr, "GGGGC: Root %p is not in the heap!\n", (void *) header);
+                        abort();
+                    }
+#endif
+                    /* the same object may be reachable from many roots, but
+                     * it only needs to be traced once */
+                    if (!ggggc_isMarked((void*) header)) {
+                        //fprintf(stderr,"First found root %lx\r\n", (long unsigned int) header);
+                        markStackPush((void *) header, 0);
+                    }
                 }
             }
             stack_iter = stack_iter->next;
@@ -126,106 +149,548 @@ void ggggc_mark()
     }
 }
 
-void ggggc_markHelper()
+void ggggc_mark()
 {
-    // Pop off our mark stack...
-    void * x = StackLL_Pop();
+    scanRoots();
+    ggggc_markHelper();
+}
 
-    while(x)
-    {
-        if (ggggc_isMarked(x)) {
-            x = StackLL_Pop();
+/* Scan the slots of a pointer array from the given slot, a chunk at a time */
+static void markPointerArray(void *x, ggc_size_t from)
+{
+    struct GGGGC_Descriptor *descriptor = (struct GGGGC_Descriptor *) ggggc_cleanMark(x);
+    void **slots = (void **) x;
+    ggc_size_t end = descriptor->size;
+
+    markParent = x;
+
+    /* leave the rest of a huge array for later, so it can't stall us */
+    if (end - from > GGGGC_MARK_CHUNK_WORDS) {
+        end = from + GGGGC_MARK_CHUNK_WORDS;
+        markStackPush(x, end);
+    }
+
+    /* most arrays are sparse, so skip runs of NULLs four at a time */
+    for (; from + 4 <= end; from += 4) {
+        if (!((ggc_size_t) slots[from] | (ggc_size_t) slots[from+1] |
+              (ggc_size_t) slots[from+2] | (ggc_size_t) slots[from+3]))
             continue;
-        }
-        // Get the descriptor for this object by dereferencing the cleaned descriptor ptr
-        struct GGGGC_Descriptor *descriptor = (struct GGGGC_Descriptor *) ggggc_cleanMark(x);
-        ggggc_markObject(x);
-        //printf("Trying to read the descriptor of an object at %lx and that descriptor is %lx\r\n", (long unsigned int) x, (long unsigned int) (((struct GGGGC_Header *) x)->descriptor__ptr));
-        if (descriptor->pointers[0]&1) {
-            long unsigned int bitIter = 1;
-            int z = 0;
-            while (z < descriptor->size) {
-                if (descriptor->pointers[0] & bitIter) {
-                    /* so we found a pointer in our object so check it out */
-                    void * newPtr = (void *) (((ggc_size_t *) x)+z);
-                    struct GGGGC_Header **newHeader = (struct GGGGC_Header **) newPtr;
-                    if (*newHeader) {
-                        struct GGGGC_Header * next = *newHeader;
-                        if (!z) {
-                            // If z is 0 this is our descriptor ptr and we need to clean it first.
-                            next = (struct GGGGC_Header *) descriptor;
-                        }
-                        //fprintf(stderr,"Object at %lx points to %lx in its %d word\r\n", (long unsigned int) x, (long unsigned int) next, z);
-                        StackLL_Push((void *) next);
-                    }
+        if (slots[from]) markStackPush(slots[from], 0);
+        if (slots[from+1]) markStackPush(slots[from+1], 0);
+        if (slots[from+2]) markStackPush(slots[from+2], 0);
+        if (slots[from+3]) markStackPush(slots[from+3], 0);
+    }
+    for (; from < end; from++)
+        if (slots[from]) markStackPush(slots[from], 0);
+}
+
+/* Mark a single object and push everything it points to */
+static inline void markScan(void *x)
+{
+    if (ggggc_isMarked(x)) {
+        return;
+    }
+    // Get the descriptor for this object by dereferencing the cleaned descriptor ptr
+    struct GGGGC_Descriptor *descriptor = (struct GGGGC_Descriptor *) ggggc_cleanMark(x);
+    ggggc_markObject(x);
+    markParent = x;
+    markedObjects++;
+    markedWords += descriptor->size;
+    // The descriptor pointer is always traced, but through its cleaned value
+    markStackPush((void *) descriptor, 0);
+    if (descriptor->flags & GGGGC_DESCRIPTOR_FLAG_POINTER_ARRAY) {
+        markPointerArray(x, GGGGC_WORD_SIZEOF(struct GGGGC_Array));
+    } else if (descriptor->pointers[0]&1) {
+        /* Walk every word of the bitmap, visiting only the set bits */
+        ggc_size_t words = GGGGC_DESCRIPTOR_WORDS_REQ(descriptor->size);
+        ggc_size_t w;
+        for (w = 0; w < words; w++) {
+            ggc_size_t bits = descriptor->pointers[w];
+            if (!w) bits &= ~((ggc_size_t) 1);
+            while (bits) {
+                ggc_size_t z = w * GGGGC_BITS_PER_WORD + GGGGC_CTZ(bits);
+                struct GGGGC_Header *next = ((struct GGGGC_Header **) x)[z];
+                bits &= bits - 1;
+                if (next) {
+                    //fprintf(stderr,"Object at %lx points to %lx in its %d word\r\n", (long unsigned int) x, (long unsigned int) next, z);
+                    markStackPush((void *) next, 0);
                 }
-                z++;
-                bitIter = bitIter << 1;
             }
-        } else {
-            // It only has it's descriptor ptr in it, this is still necessary to check.
-            StackLL_Push((void *) descriptor);
         }
-        x = StackLL_Pop();
     }
 }
 
+void ggggc_markHelper()
+{
+#if GGGGC_PREFETCH_DEPTH > 0
+    /* objects go through this FIFO on their way off the stack, so that their
+     * headers have been prefetched by the time we scan them */
+    void *fifo[GGGGC_PREFETCH_DEPTH];
+    ggc_size_t fifoHead = 0, fifoCount = 0;
+#else
+    const ggc_size_t fifoCount = 0;
+#endif
 
-void ggggc_sweep()
+    // Pop off our mark stack...
+    while (markStackTop || fifoCount) {
+        void *x;
+        if (markStackTop) {
+            struct GGGGC_MarkEntry *entry = &markStack[--markStackTop];
+            x = entry->obj;
+            if (entry->from) {
+                // The rest of an array we've already marked
+                markPointerArray(x, entry->from);
+                continue;
+            }
+#if GGGGC_PREFETCH_DEPTH > 0
+            GGGGC_PREFETCH(x);
+            if (fifoCount < GGGGC_PREFETCH_DEPTH) {
+                ggc_size_t tail = fifoHead + fifoCount++;
+                if (tail >= GGGGC_PREFETCH_DEPTH) tail -= GGGGC_PREFETCH_DEPTH;
+                fifo[tail] = x;
+                continue;
+            }
+
+            /* the FIFO is full, so x replaces the oldest object */
+            {
+                void *oldest = fifo[fifoHead];
+                fifo[fifoHead] = x;
+                x = oldest;
+            }
+            if (++fifoHead == GGGGC_PREFETCH_DEPTH) fifoHead = 0;
+#endif
+        }
+#if GGGGC_PREFETCH_DEPTH > 0
+        else {
+            /* nothing left on the stack, so drain the FIFO */
+            x = fifo[fifoHead];
+            fifoCount--;
+            if (++fifoHead == GGGGC_PREFETCH_DEPTH) fifoHead = 0;
+        }
+#endif
+        markScan(x);
+    }
+}
+
+
+/* sweeping is done a pool at a time, so that it can be spread out over
+ * allocation and idle time after the mark. sweepLink is the link to the next
+ * pool to sweep; the allocator only ever uses pools before it. */
+int ggggc_sweepPending;
+static struct GGGGC_Pool **sweepLink;
+static ggc_size_t sweepSurvivors, sweepTime;
+static ggc_size_t freedObjects, freedWords, freeEntries, freeWords;
+static ggc_size_t freeRuns, largestRuns, largestRun;
+
+/* what the pacer needs to know about the collection in progress */
+static ggc_size_t collectStart, rootTime, markTime, sweptWords, cycleAllocated;
+
+/* Every array has its own descriptor, which usually dies with it, and a dead
+ * descriptor may be swept before the objects it describes, in pools not yet
+ * swept, whose sizes still come from it. So dead descriptors are held, neither
+ * free nor counted as surviving, until the sweep is done. A held descriptor
+ * still ends a run of free objects, as a survivor would. */
+static struct GGGGC_Descriptor **held;
+static ggc_size_t heldUsed, heldSize;
+
+static void holdDescriptor(struct GGGGC_Descriptor *descriptor)
 {
-    struct GGGGC_Pool *poolIter =  ggggc_poolList;
-    //printf("pooliter is %lx\r\n", (long unsigned int) poolIter);
-    while (poolIter) {
-        ggc_size_t * iter = poolIter->start;
-        poolIter->freeList = NULL;
-        struct GGGGC_FreeObject * oldFree = NULL;
-        while (iter < poolIter->free && iter) {
-            /* if object is not marked add to free list... */
-            struct GGGGC_Descriptor *desc = ggggc_cleanMark((void *) iter);
-            size_t size;
-            size = desc->size;
-            if (ggggc_isMarked(iter)) {
-                ggggc_unmarkObject(iter);
-            } else {
-                // Should put it on the freelist if it's not reachable! duh.
-                // Right now putting each object we find at the START Of the freelist... maybe not
-                // the best but oh well. Easily solved by adding a variable to keep track of
-                // where we are in the free list.
-                // Turns out after some testing doing it this way is WAYYYYYYYYYYY faster for
-                // the bench test program so.... yeah gonna keep doing it this way...
-                struct GGGGC_FreeObject *newFree = (struct GGGGC_FreeObject *) iter;
-                newFree->next = poolIter->freeList;
-                poolIter->freeList = newFree;
-                /*
-                if (oldFree) {
-                    oldFree->next = newFree;
-                    oldFree = newFree;
+    if (heldUsed == heldSize) {
+        heldSize = heldSize ? heldSize * 2 : 256;
+        held = (struct GGGGC_Descriptor **)
+            realloc(held, heldSize * sizeof(struct GGGGC_Descriptor *));
+        if (!held) {
+            perror("realloc");
+            abort();
+        }
+    }
+    held[heldUsed++] = descriptor;
+}
+
+/* the sweep is done, so the held descriptors can go on their free lists */
+static void releaseDescriptors(void)
+{
+    ggc_size_t i;
+    for (i = 0; i < heldUsed; i++) {
+        struct GGGGC_FreeObject *newFree = (struct GGGGC_FreeObject *) held[i];
+        struct GGGGC_Pool *pool = GGGGC_POOL_OF(newFree);
+        ggc_size_t size = GGGGC_DESCRIPTOR_OF(newFree)->size;
+        newFree->size = GGGGC_FREE_HEADER(size);
+        newFree->next = pool->freeList;
+        pool->freeList = newFree;
+        pool->freeWords += size;
+        pool->sizeClasses[GGGGC_MSB(size)]++;
+        /* it ended the runs on either side of it, so it's a run of its own */
+        pool->runs++;
+        freeRuns++;
+        if (size > pool->largestRun) {
+            largestRuns += size - pool->largestRun;
+            pool->largestRun = size;
+        }
+        if (size > largestRun) largestRun = size;
+        freedObjects++;
+        freedWords += size;
+        freeEntries++;
+        freeWords += size;
+    }
+    heldUsed = 0;
+}
+
+/* sweep the pool at sweepLink, returning it, or NULL if nothing in it
+ * survived and it was released */
+static struct GGGGC_Pool *sweepPool()
+{
+    extern ggc_size_t ggggc_poolCount;
+    struct GGGGC_Pool *poolIter = *sweepLink;
+    ggc_size_t * iter = poolIter->start;
+    /* everything past the last survivor can go back to bump allocation */
+    ggc_size_t * liveEnd = poolIter->start;
+    ggc_size_t entries = 0, words = 0, run = 0, heldHere = 0;
+
+    poolIter->freeList = NULL;
+    poolIter->survivors = 0;
+    poolIter->largestRun = poolIter->runs = 0;
+    memset(poolIter->sizeClasses, 0, sizeof(poolIter->sizeClasses));
+    while (iter < poolIter->free && iter) {
+        size_t size;
+        if (GGGGC_IS_FREE(iter)) {
+            /* already free, just needs to go back on the free list */
+            size = GGGGC_FREE_SIZE(iter);
+        } else {
+            struct GGGGC_Descriptor *descriptor = GGGGC_DESCRIPTOR_OF(iter);
+            int live = !ggggc_isMarked(iter);
+            size = descriptor->size;
+            if (live || (size < GGGGC_DESCRIPTOR_DESCRIPTORS &&
+                         ggggc_descriptorDescriptors[size] == descriptor)) {
+                if (live) {
+                    /* the epoch has already flipped, so what the mark reached
+                     * is now unmarked for next time, and it's the dead
+                     * objects that look marked: leave the live ones alone */
+                    if (ggggc_censusActive)
+                        ggggc_censusCount(descriptor, size);
+                    poolIter->survivors += size;
                 } else {
-                    newFree->next = NULL;
-                    poolIter->freeList = newFree;
-                    oldFree = newFree;
-                }*/
-                //printf("Free object found at %lx\r\n", (long unsigned int) newFree);
+                    /* a dead descriptor, kept until the sweep is done */
+                    holdDescriptor((struct GGGGC_Descriptor *) iter);
+                    heldHere++;
+                }
+                if (run) {
+                    /* the end of a run of free objects */
+                    poolIter->runs++;
+                    if (run > poolIter->largestRun) poolIter->largestRun = run;
+                    run = 0;
+                }
+                iter = iter + size;
+                liveEnd = iter;
+                continue;
             }
-            iter = iter + size;
+            ((struct GGGGC_FreeObject *) iter)->size = GGGGC_FREE_HEADER(size);
+            freedObjects++;
+            freedWords += size;
         }
-        poolIter = poolIter->next; 
+        // Should put it on the freelist if it's not reachable! duh.
+        // Right now putting each object we find at the START Of the freelist... maybe not
+        // the best but oh well. Easily solved by adding a variable to keep track of
+        // where we are in the free list.
+        // Turns out after some testing doing it this way is WAYYYYYYYYYYY faster for
+        // the bench test program so.... yeah gonna keep doing it this way...
+        struct GGGGC_FreeObject *newFree = (struct GGGGC_FreeObject *) iter;
+        newFree->next = poolIter->freeList;
+        poolIter->freeList = newFree;
+        entries++;
+        words += size;
+        run += size;
+        poolIter->sizeClasses[GGGGC_MSB(size)]++;
+        //printf("Free object found at %lx\r\n", (long unsigned int) newFree);
+        iter = iter + size;
     }
+
+    sweepSurvivors += poolIter->survivors;
+    if (!poolIter->survivors && !heldHere) {
+        /* nothing survived, so the whole pool can be reused for anything */
+        GGGGC_PROBE2(sweep__pool, poolIter, 0);
+        *sweepLink = poolIter->next;
+        poolIter->next = NULL;
+        ggggc_freeGeneration(poolIter);
+        ggggc_poolCount--;
+        return NULL;
+    }
+
+    /* the free list is in reverse address order, so the free objects
+     * after the last survivor are all at its head. They're also the run
+     * that was never ended. */
+    while (poolIter->freeList && (ggc_size_t *) poolIter->freeList >= liveEnd) {
+        ggc_size_t size = GGGGC_FREE_SIZE(poolIter->freeList);
+        entries--;
+        words -= size;
+        poolIter->sizeClasses[GGGGC_MSB(size)]--;
+        poolIter->freeList = poolIter->freeList->next;
+    }
+    poolIter->free = liveEnd;
+    poolIter->freeWords = words;
+    freeEntries += entries;
+    freeWords += words;
+    freeRuns += poolIter->runs;
+    largestRuns += poolIter->largestRun;
+    if (poolIter->largestRun > largestRun) largestRun = poolIter->largestRun;
+
+    sweepLink = &poolIter->next;
+    GGGGC_PROBE2(sweep__pool, poolIter,
+        poolIter->survivors * sizeof(ggc_size_t));
+    return poolIter;
+}
+
+static void finishCollection(void);
+
+/* sweep pools until one survives, returning it, or NULL if the sweep is
+ * finished */
+struct GGGGC_Pool *ggggc_sweepNext()
+{
+    struct GGGGC_Pool *ret = NULL;
+    ggc_size_t start;
+
+    if (!ggggc_sweepPending) return NULL;
+
+    start = ggggc_now();
+    if (ggggc_counting) ggggc_countersBegin();
+    if (ggggc_tracing) {
+        /* one span per pool */
+        ggc_size_t poolStart = start, poolEnd;
+        while (*sweepLink) {
+            ret = sweepPool();
+            poolEnd = ggggc_now();
+            GGGGC_TRACE_SPAN("sweep pool", poolStart, poolEnd, "survivors",
+                ret ? ret->survivors * sizeof(ggc_size_t) : 0);
+            poolStart = poolEnd;
+            if (ret) break;
+        }
+    } else {
+        while (*sweepLink && !(ret = sweepPool()));
+    }
+    sweepTime += ggggc_now() - start;
+    if (ggggc_counting) ggggc_countersEnd(GGGGC_PHASE_SWEEP);
+
+    if (!ret) finishCollection();
+    return ret;
+}
+
+/* the next pool to allocate in after this one, swept first if need be */
+struct GGGGC_Pool *ggggc_sweptNext(struct GGGGC_Pool *pool)
+{
+    if (ggggc_sweepPending && sweepLink == &pool->next) {
+        ggc_size_t start = ggggc_now();
+        struct GGGGC_Pool *next = ggggc_sweepNext();
+        ggc_size_t end = ggggc_now();
+        ggggc_recordPause(start, end);
+        GGGGC_TRACE_SPAN("lazy sweep", start, end, NULL, 0);
+        if (next) return next;
+    }
+    return pool->next;
+}
+
+/* finish any sweep in progress */
+void ggggc_sweep()
+{
+    while (ggggc_sweepPending) ggggc_sweepNext();
+}
+
+/* a monotonic clock, in nanoseconds */
+ggc_size_t ggggc_now()
+{
+#if defined(CLOCK_MONOTONIC)
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (ggc_size_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+#else
+    return (ggc_size_t) ((double) clock() * 1000000000 / CLOCKS_PER_SEC);
+#endif
+}
+
+/* fold a new measurement into a rate, favoring recent collections */
+static double smoothRate(double rate, double sample)
+{
+    if (rate <= 0) return sample;
+    return (rate + sample) / 2;
+}
+
+/* measure how the last collection went, for the pacer */
+static void measureCollection(ggc_size_t end)
+{
+    static ggc_size_t lastEnd = 0;
+    ggc_size_t liveWords = ggggc_stats.liveBytes / sizeof(ggc_size_t);
+    ggc_size_t pause = markTime + sweepTime;
+    struct GGGGC_Stats *s = &ggggc_stats;
+
+    if (markTime)
+        ggggc_markRate = smoothRate(ggggc_markRate,
+            (double) liveWords / markTime);
+    if (sweepTime)
+        ggggc_sweepRate = smoothRate(ggggc_sweepRate,
+            (double) sweptWords / sweepTime);
+    if (lastEnd && collectStart > lastEnd) {
+        ggggc_allocRate = smoothRate(ggggc_allocRate,
+            (double) cycleAllocated / (collectStart - lastEnd));
+        ggggc_stats.gcCpuPercent = pause * 100 / (end - lastEnd);
+    }
+    lastEnd = end;
+
+    s->lastPauseNs = pause;
+    s->lastRootScanNs = rootTime;
+    s->lastMarkNs = markTime - rootTime;
+    s->lastSweepNs = sweepTime;
+    s->totalPauseNs += pause;
+    s->totalRootScanNs += rootTime;
+    s->totalMarkNs += markTime - rootTime;
+    s->totalSweepNs += sweepTime;
+    if (pause > s->maxPauseNs) s->maxPauseNs = pause;
+
+    s->markedObjects = markedObjects;
+    s->markedBytes = markedWords * sizeof(ggc_size_t);
+    s->freedObjects = freedObjects;
+    s->freedBytes = freedWords * sizeof(ggc_size_t);
+    s->totalFreedBytes += s->freedBytes;
+    s->freeListEntries = freeEntries;
+    s->freeListBytes = freeWords * sizeof(ggc_size_t);
+    s->freeRuns = freeRuns;
+    s->largestFreeRunBytes = largestRun * sizeof(ggc_size_t);
+    s->fragmentationPercent = freeWords ?
+        (freeWords - largestRuns) * 100 / freeWords : 0;
+
+    ggggc_stats.markRate = (ggc_size_t) (ggggc_markRate * 1000000);
+    ggggc_stats.sweepRate = (ggc_size_t) (ggggc_sweepRate * 1000000);
+    ggggc_stats.allocRate = (ggc_size_t) (ggggc_allocRate * 1000000);
+}
+
+/* mark, and get ready to sweep */
+static void startCollection()
+{
+    /* finish the last collection's sweep first */
+    ggggc_sweep();
+
+    /* the sweep takes the census, if one's been asked for */
+    if (ggggc_censusRequested && !ggggc_censusActive) ggggc_censusStart();
+
+    collectStart = ggggc_now();
+    GGGGC_PROBE1(collection__start, ggggc_stats.collections + 1);
+    GGGGC_PROBE(mark__start);
+    cycleAllocated = ggggc_allocatedWords;
+    ggggc_stats.allocatedBytes += cycleAllocated * sizeof(ggc_size_t);
+    markedObjects = markedWords = 0;
+    if (ggggc_counting) ggggc_countersBegin();
+    //printf("running mark\r\n");
+    scanRoots();
+    rootTime = ggggc_now() - collectStart;
+    ggggc_markHelper();
+    ggggc_profileMarked();
+    markTime = ggggc_now() - collectStart;
+    if (ggggc_counting) ggggc_countersEnd(GGGGC_PHASE_MARK);
+    GGGGC_PROBE1(mark__end, markedWords * sizeof(ggc_size_t));
+    GGGGC_TRACE_SPAN("root scan", collectStart, collectStart + rootTime, NULL, 0);
+    GGGGC_TRACE_SPAN("mark", collectStart + rootTime, collectStart + markTime,
+        "marked bytes", markedWords * sizeof(ggc_size_t));
+
+    /* everything marked is now unmarked for the next collection, including
+     * whatever's allocated before this one's sweep is done */
+    ggggc_markEpoch ^= 1;
+
+    ggggc_sweepPending = 1;
+    sweepLink = &ggggc_poolList;
+    sweepSurvivors = sweepTime = 0;
+    freedObjects = freedWords = freeEntries = freeWords = 0;
+    freeRuns = largestRuns = largestRun = 0;
+    sweptWords = ggggc_poolCount * GGGGC_WORDS_PER_POOL;
+    ggggc_forceCollect = 0;
+    ggggc_allocatedWords = 0;
+    GGGGC_PROBE(sweep__start);
+}
+
+/* everything's swept, so size the heap for the next collection */
+static void finishCollection()
+{
+    ggggc_sweepPending = 0;
+    ggggc_stats.liveBytes = sweepSurvivors * sizeof(ggc_size_t);
+    ggggc_stats.collections++;
+    releaseDescriptors();
+    GGGGC_PROBE1(sweep__end, freedWords * sizeof(ggc_size_t));
+    measureCollection(ggggc_now());
+    if (ggggc_censusActive) ggggc_censusFinish();
+
+#ifdef GGGGC_DEBUG_REPORT_COLLECTIONS
+    fprintf(stderr, "GGGGC: collection %lu: %lu usec (roots %lu, mark %lu, "
+                    "sweep %lu), %lu bytes live, %lu freed, %lu pools\n",
+        (unsigned long) ggggc_stats.collections,
+        (unsigned long) ggggc_stats.lastPauseNs / 1000,
+        (unsigned long) ggggc_stats.lastRootScanNs / 1000,
+        (unsigned long) ggggc_stats.lastMarkNs / 1000,
+        (unsigned long) ggggc_stats.lastSweepNs / 1000,
+        (unsigned long) ggggc_stats.liveBytes,
+        (unsigned long) ggggc_stats.freedBytes,
+        (unsigned long) ggggc_poolCount);
+#endif
+
+    /* make room for what we'll allocate before the next collection */
+    ggggc_resizeHeap(ggggc_stats.liveBytes / sizeof(ggc_size_t));
+
+    /* give back what we haven't needed for a while */
+    ggggc_decommitFreePools();
+
+    if (ggggc_metrics) ggggc_metricsUpdate();
+    GGGGC_PROBE2(collection__end, ggggc_stats.collections,
+        ggggc_stats.liveBytes);
 }
 
 /* run a collection */
 void ggggc_collect()
 {
-    //printf("running mark\r\n");
-    StackLL_Init();
-    ggggc_mark();
-    StackLL_Clean();
+    ggc_size_t start = ggggc_now(), end;
+
+    startCollection();
     //printf("running sweep\r\n");
     ggggc_sweep();
     // If we've ran a collection we need to reset the curpool.
     //printf("completed sweep\r\n");
-    ggggc_forceCollect = 0;
     ggggc_curPool = ggggc_poolList;
+    end = ggggc_now();
+    ggggc_recordPause(start, end);
+    GGGGC_TRACE_SPAN("collection", start, end, "live bytes",
+        ggggc_stats.liveBytes);
+}
+
+/* collect in idle time, for no more than about budgetUs microseconds */
+int ggggc_collectIdle(ggc_size_t budgetUs)
+{
+    ggc_size_t start = ggggc_now(), end;
+    ggc_size_t deadline = start + budgetUs * 1000;
+
+    if (!ggggc_sweepPending) {
+        ggc_size_t liveWords = ggggc_stats.liveBytes / sizeof(ggc_size_t);
+
+        /* not worth collecting yet? */
+        if (!ggggc_poolList ||
+            ggggc_allocatedWords < ggggc_collectThreshold / 2)
+            return 0;
+
+        /* the mark can't be split up, so only start one that will fit */
+        if (ggggc_markRate > 0 && liveWords / ggggc_markRate > budgetUs * 1000)
+            return 0;
+
+        startCollection();
+        ggggc_stats.idleCollections++;
+
+        /* the allocator needs a swept pool to work in */
+        ggggc_curPool = ggggc_sweepNext();
+        if (!ggggc_curPool) ggggc_curPool = ggggc_poolList;
+    }
+
+    /* then sweep what we've got time for */
+    while (ggggc_sweepPending && ggggc_now() < deadline)
+        ggggc_sweepNext();
+
+    /* the program was idle, but it still couldn't do anything else */
+    end = ggggc_now();
+    ggggc_recordPause(start, end);
+    GGGGC_TRACE_SPAN("idle collection", start, end, NULL, 0);
+    return ggggc_sweepPending;
 }
 
 
@@ -233,7 +698,7 @@ void ggggc_collect()
 int ggggc_yield()
 {
     /* FILLME */
-    if (ggggc_forceCollect) {
+    if (ggggc_forceCollect || ggggc_censusRequested) {
         ggggc_collect();
     }
     return 0;
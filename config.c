@@ -0,0 +1,195 @@
+/*
+ * Runtime configuration
+ *
+ * Copyright (c) 2014, 2015 Gregor Richards
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION
+ * OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/types.h>
+
+#include "ggggc/gc.h"
+#include "ggggc-internals.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* get the configuration currently in effect */
+void ggggc_getConfig(struct GGGGC_Config *config)
+{
+    config->heapMin = ggggc_heapMin * sizeof(ggc_size_t);
+    config->heapMax = ggggc_heapMax * sizeof(ggc_size_t);
+    config->heapLimit = ggggc_heapLimit * sizeof(ggc_size_t);
+    config->growthPercent = ggggc_growthPercent;
+    config->pauseTargetUs = ggggc_pauseTarget / 1000;
+    config->gcCpuPercent = ggggc_gcCpuPercent;
+    config->hugePages = ggggc_hugePages;
+    config->decommitDelay = ggggc_decommitDelay;
+    config->retainedPools = ggggc_retainedPools;
+    config->reportStats = ggggc_reportStats;
+    config->traceFile = NULL;
+    config->censusSignal = 0;
+    config->profileRate = ggggc_profileRate;
+    config->profileFile = NULL;
+    config->metricsName = NULL;
+    config->counters = ggggc_counting;
+}
+
+/* read a size from the environment, with an optional K, M or G suffix */
+static void envSize(const char *name, ggc_size_t *to)
+{
+    const char *val;
+    char *end;
+    unsigned long long ret;
+
+    val = getenv(name);
+    if (!val || !val[0]) return;
+
+    ret = strtoull(val, &end, 0);
+    switch (*end) {
+        case 'g': case 'G': ret <<= 10;
+            /* fallthrough */
+        case 'm': case 'M': ret <<= 10;
+            /* fallthrough */
+        case 'k': case 'K': ret <<= 10;
+            end++;
+    }
+    if (*end) {
+        fprintf(stderr, "GGGGC: ignoring invalid %s=%s\n", name, val);
+        return;
+    }
+
+    *to = (ggc_size_t) ret;
+}
+
+/* and the same for something that isn't a size */
+static void envUnsigned(const char *name, unsigned *to)
+{
+    ggc_size_t val = *to;
+    envSize(name, &val);
+    *to = (unsigned) val;
+}
+
+/* and for a flag or a number that's an int */
+static void envInt(const char *name, int *to)
+{
+    ggc_size_t val = (ggc_size_t) *to;
+    envSize(name, &val);
+    *to = (int) val;
+}
+
+/* print the statistics at exit */
+static void reportStats(void)
+{
+    struct GGGGC_Stats stats;
+
+    ggggc_getStats(&stats);
+    fprintf(stderr, "GGGGC: %lu collections, %lu msec collecting (roots %lu, "
+                    "mark %lu, sweep %lu), longest pause %lu usec\n",
+        (unsigned long) stats.collections,
+        (unsigned long) stats.totalPauseNs / 1000000,
+        (unsigned long) stats.totalRootScanNs / 1000000,
+        (unsigned long) stats.totalMarkNs / 1000000,
+        (unsigned long) stats.totalSweepNs / 1000000,
+        (unsigned long) stats.maxPauseNs / 1000);
+    fprintf(stderr, "GGGGC: %lu objects (%lu bytes) allocated, %lu bytes "
+                    "freed, %lu bytes live\n",
+        (unsigned long) stats.allocatedObjects,
+        (unsigned long) stats.allocatedBytes,
+        (unsigned long) stats.totalFreedBytes,
+        (unsigned long) stats.liveBytes);
+    fprintf(stderr, "GGGGC: %lu pools in use, %lu free, %lu returned to the "
+                    "OS, %lu free list entries (%lu bytes)\n",
+        (unsigned long) stats.poolCount,
+        (unsigned long) stats.freePoolCount,
+        (unsigned long) stats.decommittedPoolCount,
+        (unsigned long) stats.freeListEntries,
+        (unsigned long) stats.freeListBytes);
+    fprintf(stderr, "GGGGC: free lists in %lu runs, longest %lu bytes, %lu%% "
+                    "fragmented\n",
+        (unsigned long) stats.freeRuns,
+        (unsigned long) stats.largestFreeRunBytes,
+        (unsigned long) stats.fragmentationPercent);
+    ggggc_reportPauses();
+    ggggc_reportLifetimes();
+    ggggc_reportCounters();
+}
+
+/* configure the collector, from the given configuration (or what's already in
+ * effect if NULL) overridden by the environment */
+void ggggc_init(const struct GGGGC_Config *config)
+{
+    struct GGGGC_Config c;
+    static int reporting = 0;
+
+    if (config) c = *config;
+    else ggggc_getConfig(&c);
+
+    envSize("GGGGC_HEAP_MIN", &c.heapMin);
+    envSize("GGGGC_HEAP_MAX", &c.heapMax);
+    envSize("GGGGC_HEAP_LIMIT", &c.heapLimit);
+    envUnsigned("GGGGC_GROWTH_PERCENT", &c.growthPercent);
+    envSize("GGGGC_PAUSE_TARGET_US", &c.pauseTargetUs);
+    envUnsigned("GGGGC_GC_CPU_PERCENT", &c.gcCpuPercent);
+    envInt("GGGGC_HUGE_PAGES", &c.hugePages);
+    envSize("GGGGC_DECOMMIT_DELAY", &c.decommitDelay);
+    envSize("GGGGC_RETAINED_POOLS", &c.retainedPools);
+    envInt("GGGGC_STATS", &c.reportStats);
+    if (getenv("GGGGC_TRACE") && getenv("GGGGC_TRACE")[0])
+        c.traceFile = getenv("GGGGC_TRACE");
+    envInt("GGGGC_CENSUS_SIGNAL", &c.censusSignal);
+    envSize("GGGGC_PROFILE_RATE", &c.profileRate);
+    if (getenv("GGGGC_PROFILE") && getenv("GGGGC_PROFILE")[0])
+        c.profileFile = getenv("GGGGC_PROFILE");
+    if (getenv("GGGGC_METRICS") && getenv("GGGGC_METRICS")[0])
+        c.metricsName = (getenv("GGGGC_METRICS")[0] == '/') ?
+            getenv("GGGGC_METRICS") : "";
+    envInt("GGGGC_COUNTERS", &c.counters);
+
+    ggggc_heapMin = c.heapMin / sizeof(ggc_size_t);
+    ggggc_heapMax = c.heapMax / sizeof(ggc_size_t);
+    ggggc_heapLimit = c.heapLimit / sizeof(ggc_size_t);
+    ggggc_growthPercent = c.growthPercent;
+    ggggc_pauseTarget = c.pauseTargetUs * 1000;
+    ggggc_gcCpuPercent = c.gcCpuPercent;
+    ggggc_hugePages = c.hugePages;
+    ggggc_decommitDelay = c.decommitDelay;
+    ggggc_retainedPools = c.retainedPools;
+    ggggc_reportStats = c.reportStats;
+    ggggc_initialized = 1;
+
+    if (ggggc_reportStats && !reporting) {
+        reporting = 1;
+        atexit(reportStats);
+    }
+
+    if (c.traceFile) ggggc_traceStart(c.traceFile);
+    if (c.censusSignal) ggggc_censusOnSignal(c.censusSignal);
+    if (c.profileFile) {
+        if (!c.profileRate) c.profileRate = GGGGC_PROFILE_RATE;
+        ggggc_profileOnExit(c.profileFile);
+    }
+    if (c.profileRate != ggggc_profileRate) ggggc_profileStart(c.profileRate);
+    if (c.metricsName) ggggc_metricsPublish(c.metricsName);
+    if (c.counters && !ggggc_counting && !ggggc_countersStart())
+        fprintf(stderr, "GGGGC: hardware counters are unavailable\n");
+
+    ggggc_resizeHeap(ggggc_stats.liveBytes / sizeof(ggc_size_t));
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,249 @@
+/*
+ * Hardware performance counters per collector phase
+ *
+ * Copyright (c) 2014, 2015 Gregor Richards
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION
+ * OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#define _DEFAULT_SOURCE /* for syscall */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "ggggc/gc.h"
+#include "ggggc-internals.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(__linux__) && defined(__NR_perf_event_open)
+#define GGGGC_COUNTERS_SUPPORTED 1
+#endif
+
+#define COUNTERS 5
+
+static const char *counterNames[COUNTERS] = {
+    "cycles", "instructions", "L1D misses", "LLC misses", "dTLB misses"
+};
+
+/* nonzero while counting */
+int ggggc_counting;
+
+/* what's been counted in each phase */
+static struct GGGGC_Counters phases[GGGGC_PHASES];
+
+static unsigned long long *counterOf(struct GGGGC_Counters *c, int counter)
+{
+    switch (counter) {
+        case 0: return &c->cycles;
+        case 1: return &c->instructions;
+        case 2: return &c->l1dMisses;
+        case 3: return &c->llcMisses;
+        default: return &c->dtlbMisses;
+    }
+}
+
+#ifdef GGGGC_COUNTERS_SUPPORTED
+/* the counters are opened as one group, so that they're all read at once and
+ * scheduled together. Any the hardware doesn't have are left out. */
+static int leader = -1;
+static int groupIndex[COUNTERS]; /* position in the group, or -1 */
+static int groupSize;
+
+/* a read of the group */
+struct GroupRead {
+    unsigned long long nr, timeEnabled, timeRunning;
+    unsigned long long values[COUNTERS];
+};
+
+/* the group as read at the start of the current phase */
+static struct GroupRead phaseStart;
+
+#define CACHE_READ_MISS(cache) ((cache) | \
+    (PERF_COUNT_HW_CACHE_OP_READ << 8) | \
+    (PERF_COUNT_HW_CACHE_RESULT_MISS << 16))
+
+static int openCounter(int counter)
+{
+    struct perf_event_attr attr;
+
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    switch (counter) {
+        case 0:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_CPU_CYCLES;
+            break;
+        case 1:
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+            break;
+        case 2:
+            attr.type = PERF_TYPE_HW_CACHE;
+            attr.config = CACHE_READ_MISS(PERF_COUNT_HW_CACHE_L1D);
+            break;
+        case 3:
+            attr.type = PERF_TYPE_HW_CACHE;
+            attr.config = CACHE_READ_MISS(PERF_COUNT_HW_CACHE_LL);
+            break;
+        default:
+            attr.type = PERF_TYPE_HW_CACHE;
+            attr.config = CACHE_READ_MISS(PERF_COUNT_HW_CACHE_DTLB);
+    }
+    attr.read_format = PERF_FORMAT_GROUP |
+        PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    attr.disabled = (leader < 0);
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+
+    return (int) syscall(__NR_perf_event_open, &attr, 0, -1, leader, 0);
+}
+
+static int readGroup(struct GroupRead *r)
+{
+    return read(leader, r, sizeof(*r)) >= (ssize_t)
+        ((3 + groupSize) * sizeof(unsigned long long));
+}
+#endif
+
+int ggggc_countersStart()
+{
+#ifdef GGGGC_COUNTERS_SUPPORTED
+    int counter;
+
+    if (ggggc_counting) return groupSize;
+
+    groupSize = 0;
+    for (counter = 0; counter < COUNTERS; counter++) {
+        int fd = openCounter(counter);
+        groupIndex[counter] = -1;
+        if (fd < 0) continue;
+        if (leader < 0) leader = fd;
+        groupIndex[counter] = groupSize++;
+    }
+    if (leader < 0) return 0;
+
+    ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    ggggc_counting = 1;
+    return groupSize;
+
+#else
+    return 0;
+
+#endif
+}
+
+/* the start of a phase */
+void ggggc_countersBegin()
+{
+#ifdef GGGGC_COUNTERS_SUPPORTED
+    if (!readGroup(&phaseStart)) phaseStart.nr = 0;
+#endif
+}
+
+/* the end of a phase: count what happened since it began */
+void ggggc_countersEnd(int phase)
+{
+#ifdef GGGGC_COUNTERS_SUPPORTED
+    struct GroupRead now;
+    unsigned long long enabled, running;
+    int counter;
+
+    if (!phaseStart.nr || !readGroup(&now)) return;
+
+    /* if the group was multiplexed with others, scale up to the whole phase */
+    enabled = now.timeEnabled - phaseStart.timeEnabled;
+    running = now.timeRunning - phaseStart.timeRunning;
+    if (!running) return;
+
+    for (counter = 0; counter < COUNTERS; counter++) {
+        int i = groupIndex[counter];
+        unsigned long long delta;
+        if (i < 0) continue;
+        delta = now.values[i] - phaseStart.values[i];
+        if (enabled != running)
+            delta = (unsigned long long) ((double) delta * enabled / running);
+        *counterOf(&phases[phase], counter) += delta;
+    }
+#else
+    (void) phase;
+#endif
+}
+
+int ggggc_counters(struct GGGGC_Counters *mark, struct GGGGC_Counters *sweep)
+{
+    int counter;
+
+    if (!ggggc_counting) return 0;
+
+    if (mark) *mark = phases[GGGGC_PHASE_MARK];
+    if (sweep) *sweep = phases[GGGGC_PHASE_SWEEP];
+#ifdef GGGGC_COUNTERS_SUPPORTED
+    for (counter = 0; counter < COUNTERS; counter++) {
+        if (groupIndex[counter] >= 0) continue;
+        if (mark) *counterOf(mark, counter) = GGGGC_COUNTER_UNAVAILABLE;
+        if (sweep) *counterOf(sweep, counter) = GGGGC_COUNTER_UNAVAILABLE;
+    }
+#else
+    (void) counter;
+#endif
+    return 1;
+}
+
+/* print what's been counted in each phase to stderr */
+void ggggc_reportCounters()
+{
+    struct GGGGC_Counters c[GGGGC_PHASES];
+    int counter, phase;
+
+    if (!ggggc_counters(&c[GGGGC_PHASE_MARK], &c[GGGGC_PHASE_SWEEP])) return;
+
+    fprintf(stderr, "GGGGC: hardware counters: %12s %16s %16s\n", "",
+        "mark", "sweep");
+    for (counter = 0; counter < COUNTERS; counter++) {
+        fprintf(stderr, "GGGGC: %38s", counterNames[counter]);
+        for (phase = 0; phase < GGGGC_PHASES; phase++) {
+            unsigned long long count = *counterOf(&c[phase], counter);
+            if (count == GGGGC_COUNTER_UNAVAILABLE)
+                fprintf(stderr, " %16s", "-");
+            else
+                fprintf(stderr, " %16llu", count);
+        }
+        fprintf(stderr, "\n");
+    }
+
+    /* instructions per cycle, if both were counted */
+    if (c[0].cycles != GGGGC_COUNTER_UNAVAILABLE &&
+        c[0].instructions != GGGGC_COUNTER_UNAVAILABLE) {
+        fprintf(stderr, "GGGGC: %38s", "instructions per cycle");
+        for (phase = 0; phase < GGGGC_PHASES; phase++)
+            fprintf(stderr, " %16.2f", c[phase].cycles ?
+                (double) c[phase].instructions / c[phase].cycles : 0.0);
+        fprintf(stderr, "\n");
+    }
+}
+
+#ifdef __cplusplus
+}
+#endif
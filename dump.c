@@ -0,0 +1,217 @@
+/*
+ * Heap dumps
+ *
+ * Copyright (c) 2014, 2015 Gregor Richards
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION
+ * OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+
+#include "ggggc/gc.h"
+#include "ggggc/dump.h"
+#include "ggggc-internals.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* the pointers in an object, as the mark traces them: its descriptor, then
+ * each set slot. edges must have room for the object's size in words. */
+static ggc_size_t edgesOf(void *x, void **edges)
+{
+    struct GGGGC_Descriptor *descriptor = GGGGC_DESCRIPTOR_OF(x);
+    void **slots = (void **) x;
+    ggc_size_t count = 0, i;
+
+    edges[count++] = descriptor;
+    if (descriptor->flags & GGGGC_DESCRIPTOR_FLAG_POINTER_ARRAY) {
+        for (i = GGGGC_WORD_SIZEOF(struct GGGGC_Array); i < descriptor->size;
+             i++)
+            if (slots[i]) edges[count++] = slots[i];
+    } else if (descriptor->pointers[0] & 1) {
+        ggc_size_t words = GGGGC_DESCRIPTOR_WORDS_REQ(descriptor->size);
+        ggc_size_t w;
+        for (w = 0; w < words; w++) {
+            ggc_size_t bits = descriptor->pointers[w];
+            if (!w) bits &= ~((ggc_size_t) 1);
+            while (bits) {
+                i = w * GGGGC_BITS_PER_WORD + GGGGC_CTZ(bits);
+                bits &= bits - 1;
+                if (slots[i]) edges[count++] = slots[i];
+            }
+        }
+    }
+    return count;
+}
+
+/* descriptors whose type has been written, as an open-addressed set */
+static struct GGGGC_Descriptor **written;
+static ggc_size_t writtenSize, writtenUsed;
+
+static struct GGGGC_Descriptor **writtenSlot(
+    struct GGGGC_Descriptor *descriptor)
+{
+    ggc_size_t i = ((ggc_size_t) descriptor >> 3) & (writtenSize - 1);
+    while (written[i] && written[i] != descriptor)
+        i = (i + 1) & (writtenSize - 1);
+    return &written[i];
+}
+
+/* remember that a descriptor's type was written, returning 0 if it already
+ * was */
+static int firstWrite(struct GGGGC_Descriptor *descriptor)
+{
+    struct GGGGC_Descriptor **slot;
+
+    if ((writtenUsed + 1) * 2 > writtenSize) {
+        struct GGGGC_Descriptor **old = written;
+        ggc_size_t oldSize = writtenSize, i;
+        writtenSize = writtenSize ? writtenSize * 2 : 256;
+        written = (struct GGGGC_Descriptor **)
+            calloc(writtenSize, sizeof(struct GGGGC_Descriptor *));
+        if (!written) {
+            perror("calloc");
+            abort();
+        }
+        for (i = 0; i < oldSize; i++)
+            if (old[i]) *writtenSlot(old[i]) = old[i];
+        free(old);
+    }
+
+    slot = writtenSlot(descriptor);
+    if (*slot) return 0;
+    *slot = descriptor;
+    writtenUsed++;
+    return 1;
+}
+
+static void writeWord(FILE *out, ggc_size_t word)
+{
+    fwrite(&word, sizeof(ggc_size_t), 1, out);
+}
+
+static void writeType(FILE *out, struct GGGGC_Descriptor *descriptor)
+{
+    const char *name = ggggc_descriptorName(descriptor);
+    ggc_size_t length = strlen(name);
+    ggc_size_t padding = (sizeof(ggc_size_t) - length % sizeof(ggc_size_t)) %
+        sizeof(ggc_size_t);
+    static const char zeroes[sizeof(ggc_size_t)];
+
+    writeWord(out, GGGGC_DUMP_TYPE);
+    writeWord(out, (ggc_size_t) descriptor);
+    writeWord(out, length);
+    fwrite(name, 1, length, out);
+    fwrite(zeroes, 1, padding, out);
+}
+
+/* collect, then write every object left and every root to the given file */
+int ggggc_dumpHeap(const char *path)
+{
+    struct GGGGC_DumpHeader header;
+    struct GGGGC_PointerStack *frame;
+    struct GGGGC_Pool *pool;
+    FILE *out;
+    void **edges = NULL;
+    ggc_size_t edgesSize = 0, frameIndex, start;
+    int kind;
+
+    /* after a full collection, everything in the heap is alive */
+    ggggc_collect();
+    start = ggggc_now();
+
+    out = fopen(path, "wb");
+    if (!out) {
+        perror(path);
+        return 0;
+    }
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, GGGGC_DUMP_MAGIC, sizeof(header.magic));
+    header.version = GGGGC_DUMP_VERSION;
+    header.wordSize = sizeof(ggc_size_t);
+    fwrite(&header, sizeof(header), 1, out);
+
+    /* the objects, a pool at a time */
+    writtenUsed = 0;
+    if (written) memset(written, 0, writtenSize * sizeof(*written));
+    for (pool = ggggc_poolList; pool; pool = pool->next) {
+        ggc_size_t *iter = pool->start;
+        while (iter < pool->free) {
+            struct GGGGC_Descriptor *descriptor;
+            ggc_size_t count, i;
+
+            if (GGGGC_IS_FREE(iter)) {
+                iter += GGGGC_FREE_SIZE(iter);
+                continue;
+            }
+
+            descriptor = GGGGC_DESCRIPTOR_OF(iter);
+            if (firstWrite(descriptor)) writeType(out, descriptor);
+
+            if (descriptor->size + 1 > edgesSize) {
+                edgesSize = descriptor->size + 1;
+                edges = (void **) realloc(edges, edgesSize * sizeof(void *));
+                if (!edges) {
+                    perror("realloc");
+                    abort();
+                }
+            }
+            count = edgesOf(iter, edges);
+
+            writeWord(out, GGGGC_DUMP_OBJECT);
+            writeWord(out, (ggc_size_t) iter);
+            writeWord(out, (ggc_size_t) descriptor);
+            writeWord(out, descriptor->size);
+            writeWord(out, count);
+            for (i = 0; i < count; i++) writeWord(out, (ggc_size_t) edges[i]);
+
+            iter += descriptor->size;
+        }
+    }
+    free(edges);
+
+    /* then the roots. The globals are the tail of the pointer stack. */
+    kind = GGGGC_DUMP_ROOT_STACK;
+    for (frame = ggggc_pointerStack, frameIndex = 0; frame;
+         frame = frame->next, frameIndex++) {
+        ggc_size_t i;
+        if (frame == ggggc_pointerStackGlobalsStart)
+            kind = GGGGC_DUMP_ROOT_GLOBAL;
+        for (i = 0; i < frame->size; i++) {
+            void *target = *((void **) frame->pointers[i]);
+            if (!target) continue;
+            writeWord(out, GGGGC_DUMP_ROOT);
+            writeWord(out, kind);
+            writeWord(out, frameIndex);
+            writeWord(out, (ggc_size_t) target);
+        }
+    }
+
+    writeWord(out, GGGGC_DUMP_END);
+    if (fclose(out)) {
+        perror(path);
+        return 0;
+    }
+
+    GGGGC_TRACE_SPAN("heap dump", start, ggggc_now(), NULL, 0);
+    return 1;
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,109 @@
+/*
+ * Free list fragmentation
+ *
+ * Copyright (c) 2014, 2015 Gregor Richards
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION
+ * OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+
+#include "ggggc/gc.h"
+#include "ggggc-internals.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* the share of a free list, in percent, outside its longest run */
+static ggc_size_t fragmentationOf(ggc_size_t freeWords, ggc_size_t largestRun)
+{
+    return freeWords ? (freeWords - largestRun) * 100 / freeWords : 0;
+}
+
+ggc_size_t ggggc_fragmentation(struct GGGGC_PoolFragmentation *pools,
+    ggc_size_t max)
+{
+    struct GGGGC_Pool *pool;
+    ggc_size_t count = 0, i;
+
+    ggggc_sweep();
+    for (pool = ggggc_poolList; pool; pool = pool->next, count++) {
+        struct GGGGC_PoolFragmentation *p;
+        if (count >= max) continue;
+        p = &pools[count];
+        p->pool = pool;
+        p->freeBytes = pool->freeWords * sizeof(ggc_size_t);
+        p->largestRunBytes = pool->largestRun * sizeof(ggc_size_t);
+        p->runs = pool->runs;
+        p->entries = 0;
+        for (i = 0; i < GGGGC_SIZE_CLASSES; i++) {
+            p->sizeClasses[i] = pool->sizeClasses[i];
+            p->entries += pool->sizeClasses[i];
+        }
+    }
+    return count;
+}
+
+/* print each pool's free list, then the size classes of all of them */
+void ggggc_reportFragmentation()
+{
+    struct GGGGC_Pool *pool;
+    ggc_size_t classes[GGGGC_SIZE_CLASSES];
+    ggc_size_t freeWords = 0, largestRuns = 0, runs = 0, entries = 0, i;
+
+    ggggc_sweep();
+    memset(classes, 0, sizeof(classes));
+    fprintf(stderr, "GGGGC: free lists:\n"
+                    "GGGGC: %18s %14s %10s %8s %14s %5s\n",
+        "pool", "free bytes", "entries", "runs", "largest run", "frag");
+    for (pool = ggggc_poolList; pool; pool = pool->next) {
+        ggc_size_t poolEntries = 0;
+        for (i = 0; i < GGGGC_SIZE_CLASSES; i++) {
+            classes[i] += pool->sizeClasses[i];
+            poolEntries += pool->sizeClasses[i];
+        }
+        fprintf(stderr, "GGGGC: %18p %14lu %10lu %8lu %14lu %4lu%%\n",
+            (void *) pool,
+            (unsigned long) (pool->freeWords * sizeof(ggc_size_t)),
+            (unsigned long) poolEntries,
+            (unsigned long) pool->runs,
+            (unsigned long) (pool->largestRun * sizeof(ggc_size_t)),
+            (unsigned long) fragmentationOf(pool->freeWords, pool->largestRun));
+        freeWords += pool->freeWords;
+        largestRuns += pool->largestRun;
+        runs += pool->runs;
+        entries += poolEntries;
+    }
+    fprintf(stderr, "GGGGC: %18s %14lu %10lu %8lu %14s %4lu%%\n", "total",
+        (unsigned long) (freeWords * sizeof(ggc_size_t)),
+        (unsigned long) entries, (unsigned long) runs, "",
+        (unsigned long) fragmentationOf(freeWords, largestRuns));
+
+    fprintf(stderr, "GGGGC: free list entries by size:\n"
+                    "GGGGC: %23s %10s\n", "bytes", "entries");
+    for (i = 0; i < GGGGC_SIZE_CLASSES; i++) {
+        if (!classes[i]) continue;
+        fprintf(stderr, "GGGGC: %11lu-%-11lu %10lu\n",
+            (unsigned long) (((ggc_size_t) 1 << i) * sizeof(ggc_size_t)),
+            (unsigned long) ((((ggc_size_t) 2 << i) - 1) * sizeof(ggc_size_t)),
+            (unsigned long) classes[i]);
+    }
+}
+
+#ifdef __cplusplus
+}
+#endif
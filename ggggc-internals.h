@@ -19,15 +19,79 @@
 #ifndef GGGGC_INTERNALS_H
 #define GGGGC_INTERNALS_H 1
 
+#include <signal.h>
+
 #include "ggggc/gc.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/* the header shared by all arrays */
+struct GGGGC_Array {
+    struct GGGGC_Header header;
+    ggc_size_t length;
+};
+
+/* count the trailing zeroes of a nonzero word */
+#if defined(__GNUC__) && !defined(GGGGC_NO_GNUC_FEATURES)
+#define GGGGC_CTZ(x) ((ggc_size_t) \
+    ((sizeof(ggc_size_t) > sizeof(unsigned long)) ? \
+        __builtin_ctzll((unsigned long long) (x)) : \
+        __builtin_ctzl((unsigned long) (x))))
+#else
+static ggc_size_t ggggc_ctz(ggc_size_t x)
+{
+    ggc_size_t ret = 0;
+    while (!(x & 1)) {
+        x >>= 1;
+        ret++;
+    }
+    return ret;
+}
+#define GGGGC_CTZ(x) ggggc_ctz(x)
+#endif
+
+/* and find the most significant set bit of one */
+#if defined(__GNUC__) && !defined(GGGGC_NO_GNUC_FEATURES)
+#define GGGGC_MSB(x) ((int) \
+    ((sizeof(ggc_size_t) > sizeof(unsigned long)) ? \
+        sizeof(unsigned long long) * 8 - 1 - \
+            __builtin_clzll((unsigned long long) (x)) : \
+        sizeof(unsigned long) * 8 - 1 - \
+            __builtin_clzl((unsigned long) (x))))
+#else
+static inline int ggggc_msb(ggc_size_t x)
+{
+    int ret = 0;
+    while (x >>= 1) ret++;
+    return ret;
+}
+#define GGGGC_MSB(x) ggggc_msb(x)
+#endif
+
 /* sweeeeeeeeep */
 void ggggc_sweep();
 
+/* set while a collection's sweep is being done a pool at a time */
+extern int ggggc_sweepPending;
+
+/* sweep pools until one survives, returning it, or NULL if the sweep is
+ * finished */
+struct GGGGC_Pool *ggggc_sweepNext();
+
+/* the next pool to allocate in after this one, swept first if need be */
+struct GGGGC_Pool *ggggc_sweptNext(struct GGGGC_Pool *pool);
+
+/* The value of the header mark bit which means "marked". It flips after every
+   collection, so that survivors are unmarked for the next one without having
+   to be touched again */
+extern ggc_size_t ggggc_markEpoch;
+
+/* A descriptor pointer with the mark bit set to unmarked, for new objects */
+#define GGGGC_UNMARKED(descriptor) ((struct GGGGC_Descriptor *) \
+    ((ggc_size_t) (descriptor) | (ggggc_markEpoch ^ 1)))
+
 /* Pass a pointer to an object to check if it's marked
    returns 1 if marked 0 if not */
 long unsigned int ggggc_isMarked(void * x);
@@ -49,8 +113,220 @@ void ggggc_mark();
 /* Do actual marking recursion for non stack objects */
 void ggggc_markHelper();
 
-/* run a collection */
-void ggggc_collect();
+
+/* expand a generation to at least the given number of pools */
+void ggggc_expandGeneration(struct GGGGC_Pool *pool, ggc_size_t pools);
+
+/* set the next collection's threshold and grow the heap to suit the given
+ * amount of live data, after a collection or a change of policy */
+void ggggc_resizeHeap(ggc_size_t liveWords);
+
+/* the heap policy: the heap (in words) is allowed to grow to growthPercent
+ * more than what survived the last collection, within [heapMin, heapMax] (or
+ * with no maximum if heapMax is 0) */
+#ifndef GGGGC_HEAP_MIN
+#define GGGGC_HEAP_MIN (GGGGC_POOL_BYTES * 2)
+#endif
+#ifndef GGGGC_HEAP_MAX
+#define GGGGC_HEAP_MAX 0
+#endif
+#ifndef GGGGC_GROWTH_PERCENT
+#define GGGGC_GROWTH_PERCENT 100
+#endif
+extern ggc_size_t ggggc_heapMin, ggggc_heapMax;
+extern unsigned ggggc_growthPercent;
+
+/* the hard heap limit, in words (0 for none). The heap never grows past it;
+ * allocations that don't fit get an emergency collection, then the OOM
+ * handler, then fail. */
+#ifndef GGGGC_HEAP_LIMIT
+#define GGGGC_HEAP_LIMIT 0
+#endif
+extern ggc_size_t ggggc_heapLimit;
+extern int (*ggggc_oomHandler)(ggc_size_t bytes);
+
+/* words allocated since the last collection, and how many may be allocated
+ * before the next */
+extern ggc_size_t ggggc_allocatedWords, ggggc_collectThreshold;
+
+/* set when the next yield should collect */
+extern int ggggc_forceCollect;
+
+/* the pacer: a target maximum pause in nanoseconds and a target share of
+ * time spent collecting, in percent (0 for no target) */
+#ifndef GGGGC_PAUSE_TARGET_US
+#define GGGGC_PAUSE_TARGET_US 0
+#endif
+#ifndef GGGGC_GC_CPU_PERCENT
+#define GGGGC_GC_CPU_PERCENT 0
+#endif
+extern ggc_size_t ggggc_pauseTarget;
+extern unsigned ggggc_gcCpuPercent;
+
+/* rates measured by previous collections, in words per nanosecond (0 until
+ * measured), used by the pacer to predict the cost of the next */
+extern double ggggc_markRate, ggggc_sweepRate, ggggc_allocRate;
+
+/* set once the configuration has been read, and whether to report
+ * statistics at exit */
+extern int ggggc_initialized, ggggc_reportStats;
+
+/* record a pause of the mutator, from start to end in ggggc_now's clock. The
+ * last GGGGC_PAUSE_HISTORY pauses are kept for computing MMU. */
+#ifndef GGGGC_PAUSE_HISTORY
+#define GGGGC_PAUSE_HISTORY 1024
+#endif
+void ggggc_recordPause(ggc_size_t start, ggc_size_t end);
+
+/* trace events, recorded only while tracing (see GGC_TRACE_START). Times
+ * are from ggggc_now. */
+#ifndef GGGGC_TRACE_EVENTS
+#define GGGGC_TRACE_EVENTS 65536
+#endif
+extern int ggggc_tracing;
+void ggggc_traceSpan(const char *name, ggc_size_t start, ggc_size_t end,
+    const char *argName, ggc_size_t arg);
+void ggggc_traceInstant(const char *name, const char *argName, ggc_size_t arg);
+#define GGGGC_TRACE_SPAN(name, start, end, argName, arg) do { \
+    if (ggggc_tracing) ggggc_traceSpan(name, start, end, argName, arg); \
+} while (0)
+#define GGGGC_TRACE_INSTANT(name, argName, arg) do { \
+    if (ggggc_tracing) ggggc_traceInstant(name, argName, arg); \
+} while (0)
+
+/* USDT probes (provider "ggggc"), for SystemTap, bpftrace and the like. With
+ * sys/sdt.h, each is a nop until something attaches to it; without, or with
+ * GGGGC_NO_PROBES, they're not there at all. */
+#if !defined(GGGGC_PROBES) && !defined(GGGGC_NO_PROBES) && \
+    defined(__has_include)
+#if __has_include(<sys/sdt.h>)
+#define GGGGC_PROBES 1
+#endif
+#endif
+
+#if defined(GGGGC_PROBES) && !defined(GGGGC_NO_PROBES)
+#include <sys/sdt.h>
+#define GGGGC_PROBE(name) DTRACE_PROBE(ggggc, name)
+#define GGGGC_PROBE1(name, a) DTRACE_PROBE1(ggggc, name, a)
+#define GGGGC_PROBE2(name, a, b) DTRACE_PROBE2(ggggc, name, a, b)
+#else
+#define GGGGC_PROBE(name) do {} while (0)
+#define GGGGC_PROBE1(name, a) do {} while (0)
+#define GGGGC_PROBE2(name, a, b) do {} while (0)
+#endif
+
+/* allocations of at least this many words fire the large__alloc probe */
+#ifndef GGGGC_PROBE_LARGE_WORDS
+#define GGGGC_PROBE_LARGE_WORDS 4096
+#endif
+
+/* the heap census. Named slots are remembered by ggggc_nameSlot. While
+ * ggggc_censusActive, the sweep counts each live object. */
+extern int ggggc_censusActive;
+extern volatile sig_atomic_t ggggc_censusRequested;
+void ggggc_nameSlot(struct GGGGC_DescriptorSlot *slot);
+void ggggc_censusStart(void);
+void ggggc_censusCount(struct GGGGC_Descriptor *descriptor, ggc_size_t words);
+void ggggc_censusFinish(void);
+const char *ggggc_descriptorName(struct GGGGC_Descriptor *descriptor);
+
+/* the allocation profiler. Every allocation counts down ggggc_profileLeft
+ * (in words), and the one that reaches zero is sampled; it's never reached
+ * when not profiling. After each mark, the samples which weren't reached are
+ * retired. */
+#ifndef GGGGC_PROFILE_DEPTH
+#define GGGGC_PROFILE_DEPTH 32
+#endif
+#ifndef GGGGC_PROFILE_RATE
+#define GGGGC_PROFILE_RATE 524288
+#endif
+extern ggc_size_t ggggc_profileLeft, ggggc_profileRate;
+void ggggc_profileOnExit(const char *path);
+void ggggc_profileSample(void *obj, struct GGGGC_Descriptor *descriptor);
+void ggggc_profileMarked(void);
+
+/* heap snapshots. While ggggc_markParents, the mark tells
+ * ggggc_recordParent what first reached each object: another object, or a
+ * pointer stack frame with its low bit set. */
+extern int ggggc_markParents;
+void ggggc_recordParent(void *obj, void *parent);
+
+/* the shared memory metrics segment, if published, updated after every
+ * collection and pause */
+extern struct GGGGC_Metrics *ggggc_metrics;
+void ggggc_metricsUpdate(void);
+void ggggc_metricsPause(ggc_size_t ns);
+
+/* hardware performance counters. While ggggc_counting, each phase is
+ * bracketed by ggggc_countersBegin and ggggc_countersEnd. */
+#define GGGGC_PHASE_MARK    0 /* including the root scan */
+#define GGGGC_PHASE_SWEEP   1
+#define GGGGC_PHASES        2
+extern int ggggc_counting;
+void ggggc_countersBegin(void);
+void ggggc_countersEnd(int phase);
+
+/* the first of the globals at the tail of the pointer stack */
+extern struct GGGGC_PointerStack *ggggc_pointerStackGlobalsStart;
+
+/* a monotonic clock, in nanoseconds */
+ggc_size_t ggggc_now(void);
+
+/* return a list of pools to the free pools */
+void ggggc_freeGeneration(struct GGGGC_Pool *pool);
+
+/* free pools beyond the retained floor are returned to the OS once they've
+ * been free for this many collections */
+#ifndef GGGGC_DECOMMIT_DELAY
+#define GGGGC_DECOMMIT_DELAY 4
+#endif
+extern ggc_size_t ggggc_decommitDelay;
+
+/* the number of free pools kept committed regardless of how long they've been
+ * idle */
+#ifndef GGGGC_RETAINED_POOLS
+#define GGGGC_RETAINED_POOLS 1
+#endif
+extern ggc_size_t ggggc_retainedPools;
+
+/* how pools are backed: 0 for normal pages, GGGGC_HUGE_PAGES_TRANSPARENT to
+ * ask for transparent huge pages, or GGGGC_HUGE_PAGES_EXPLICIT to try
+ * explicit (hugetlbfs) huge pages first and fall back to transparent ones */
+#define GGGGC_HUGE_PAGES_TRANSPARENT 1
+#define GGGGC_HUGE_PAGES_EXPLICIT 2
+#ifndef GGGGC_HUGE_PAGES
+#define GGGGC_HUGE_PAGES 0
+#endif
+extern int ggggc_hugePages;
+
+/* the amount of address space reserved for the heap, where the allocator
+ * supports reserving it up front */
+#ifndef GGGGC_HEAP_RESERVE
+#define GGGGC_HEAP_RESERVE ((ggc_size_t) 1 << 36) /* 64GB */
+#endif
+
+/* with a reserved heap, every pool is in [ggggc_heapBase, ggggc_heapTop), so
+ * heap pointers can be recognized and pools numbered densely for side tables.
+ * Otherwise, both are NULL */
+extern unsigned char *ggggc_heapBase, *ggggc_heapTop;
+#define GGGGC_IN_HEAP(ptr) \
+    ((unsigned char *) (ptr) >= ggggc_heapBase && (unsigned char *) (ptr) < ggggc_heapTop)
+#define GGGGC_POOL_INDEX(ptr) \
+    ((ggc_size_t) ((unsigned char *) (ptr) - ggggc_heapBase) >> GGGGC_POOL_SIZE)
+
+/* the size of a huge page, which any pool must be a multiple of to use them */
+#ifndef GGGGC_HUGE_PAGE_BYTES
+#define GGGGC_HUGE_PAGE_BYTES ((ggc_size_t) 2 * 1024 * 1024)
+#endif
+
+/* return idle free pools to the OS, per the above policy */
+void ggggc_decommitFreePools(void);
+
+/* the resident set size of the process in bytes, or 0 if unknown */
+ggc_size_t ggggc_rss(void);
+
+/* statistics, mostly maintained by the collector */
+extern struct GGGGC_Stats ggggc_stats;
 
 /* the pools are thread-local */
 extern struct GGGGC_Pool *ggggc_poolList;
@@ -58,8 +334,13 @@ extern struct GGGGC_Pool *ggggc_poolList;
 /* the current allocation pool */
 extern struct GGGGC_Pool *ggggc_curPool;
 
+/* the number of pools in the pool list */
+extern ggc_size_t ggggc_poolCount;
+
 /* descriptor descriptors */
-extern struct GGGGC_Descriptor *ggggc_descriptorDescriptors[GGGGC_WORDS_PER_POOL/GGGGC_BITS_PER_WORD+sizeof(struct GGGGC_Descriptor)];
+#define GGGGC_DESCRIPTOR_DESCRIPTORS \
+    (GGGGC_WORDS_PER_POOL/GGGGC_BITS_PER_WORD+sizeof(struct GGGGC_Descriptor))
+extern struct GGGGC_Descriptor *ggggc_descriptorDescriptors[GGGGC_DESCRIPTOR_DESCRIPTORS];
 
 #ifdef __cplusplus
 }
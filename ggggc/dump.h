@@ -0,0 +1,56 @@
+/*
+ * GGGGC heap dump format
+ *
+ * Copyright (c) 2014, 2015 Gregor Richards
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION
+ * OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef GGGGC_DUMP_H
+#define GGGGC_DUMP_H 1
+
+/* A heap dump (see GGC_DUMP_HEAP) is a header followed by records, in the
+ * byte order of the machine that wrote it. Every field of a record is a word
+ * of header.wordSize bytes, starting with its tag:
+ *
+ *  GGGGC_DUMP_TYPE: descriptor, name length, then the name, padded with NULs
+ *      to a whole number of words. Written before the first object with that
+ *      descriptor.
+ *
+ *  GGGGC_DUMP_OBJECT: address, descriptor, size in words, edge count, then
+ *      the address of everything the object points to (including its
+ *      descriptor), as the collector would trace it.
+ *
+ *  GGGGC_DUMP_ROOT: GGGGC_DUMP_ROOT_STACK or GGGGC_DUMP_ROOT_GLOBAL, the
+ *      index of the pointer stack frame it's in (0 is the innermost), then
+ *      the address it refers to.
+ *
+ *  GGGGC_DUMP_END: nothing; the end of the dump.
+ */
+#define GGGGC_DUMP_MAGIC "GGGGCHD\n"
+#define GGGGC_DUMP_VERSION 1
+
+struct GGGGC_DumpHeader {
+    char magic[8];
+    unsigned int version, wordSize;
+};
+
+#define GGGGC_DUMP_END      0
+#define GGGGC_DUMP_TYPE     1
+#define GGGGC_DUMP_OBJECT   2
+#define GGGGC_DUMP_ROOT     3
+
+#define GGGGC_DUMP_ROOT_STACK   1
+#define GGGGC_DUMP_ROOT_GLOBAL  2
+
+#endif
@@ -55,18 +55,24 @@ typedef size_t ggc_size_t;
 #define GGGGC_BITS_PER_WORD (8*sizeof(ggc_size_t))
 #define GGGGC_WORDS_PER_POOL (GGGGC_POOL_BYTES/sizeof(ggc_size_t))
 #define GGGGC_FREE_MAP_SIZE (GGGGC_WORDS_PER_POOL/256)
+#define GGGGC_SIZE_CLASSES GGGGC_POOL_SIZE /* power-of-two classes of free objects */
 
 /* an empty defined for all the various conditions in which empty defines are necessary */
 #define GGGGC_EMPTY
 
 /* Free object struct for free lists, forms a list, I'm assuming that I'm enforcing
    that every object the mutator allocates is AT LEAST 1 void * large, so that I have room
-    for the descriptor ptr (where the header was) and room for the next pointer where the
-    object was...*/
+    for the size (where the header was) and room for the next pointer where the
+    object was. The size is tagged with GGGGC_FREE_TAG, which no descriptor pointer
+    can have, so a free object can always be told apart from a real one... */
 struct GGGGC_FreeObject {
-    struct GGGGC_Descriptor *descriptor__ptr;
+    ggc_size_t size; /* (size in words << 2) | GGGGC_FREE_TAG */
     struct GGGGC_FreeObject *next;
 };
+#define GGGGC_FREE_TAG 0x2
+#define GGGGC_FREE_HEADER(sz) (((ggc_size_t) (sz) << 2) | GGGGC_FREE_TAG)
+#define GGGGC_FREE_SIZE(obj) (((struct GGGGC_FreeObject *) (obj))->size >> 2)
+#define GGGGC_IS_FREE(obj) (((struct GGGGC_FreeObject *) (obj))->size & GGGGC_FREE_TAG)
 
 /* GC pool (forms a list) */
 struct GGGGC_Pool {
@@ -82,25 +88,47 @@ struct GGGGC_Pool {
     /* how much survived the last collection */
     ggc_size_t survivors;
 
+    /* the free list the last sweep left, in words: its total, the longest
+     * run of adjacent free objects, the number of runs, and the number of
+     * entries in each size class (2^i to 2^(i+1)-1 words) */
+    ggc_size_t freeWords, largestRun, runs;
+    ggc_size_t sizeClasses[GGGGC_SIZE_CLASSES];
+
+    /* while free, the collection at which this pool was freed, and whether
+     * its memory has been returned to the OS */
+    ggc_size_t freedAt;
+    int decommitted;
+
     /* and the actual content */
     ggc_size_t start[1];
     
 };
 
-/* GC header (this shape must be shared by all GC'd objects) */
+/* GC header (this shape must be shared by all GC'd objects). The low bit of
+ * the descriptor pointer is the collector's mark bit, so always get the
+ * descriptor through GGGGC_DESCRIPTOR_OF */
 struct GGGGC_Header {
     struct GGGGC_Descriptor *descriptor__ptr;
 };
+#define GGGGC_DESCRIPTOR_OF(object) ((struct GGGGC_Descriptor *) \
+    ((ggc_size_t) ((struct GGGGC_Header *) (object))->descriptor__ptr & ~((ggc_size_t) 1)))
 
 /* GGGGC descriptors are GC objects that describe the shape of other GC objects */
 struct GGGGC_Descriptor {
     struct GGGGC_Header header;
     void *user__ptr; /* for the user to use however they please */
     ggc_size_t size; /* size of the described object in words */
+    ggc_size_t flags; /* GGGGC_DESCRIPTOR_FLAG_* */
     ggc_size_t pointers[1]; /* location of pointers within the object (as a special
                          * case, if pointers[0]&1==0, this means "no pointers") */
 };
 #define GGGGC_DESCRIPTOR_DESCRIPTION 0x3 /* first two words are pointers */
+#define GGGGC_DESCRIPTOR_FLAG_POINTER_ARRAY 0x1 /* every word after the array
+                                                 * header is a pointer, and
+                                                 * pointers is not consulted */
+#define GGGGC_DESCRIPTOR_FLAG_NAMED 0x2 /* made from a named descriptor slot */
+#define GGGGC_DESCRIPTOR_NAME_SHIFT 2 /* and, if so, the flags above this are
+                                       * which named type it is */
 #define GGGGC_DESCRIPTOR_WORDS_REQ(sz) (((sz) + GGGGC_BITS_PER_WORD - 1) / GGGGC_BITS_PER_WORD)
 
 /* descriptor slots are global locations where descriptors may eventually be
@@ -108,9 +136,59 @@ struct GGGGC_Descriptor {
 struct GGGGC_DescriptorSlot {
     struct GGGGC_Descriptor *descriptor;
     ggc_size_t size;
-    ggc_size_t pointers;
+    ggc_size_t (*pointers)(ggc_size_t word); /* the given word of the pointer
+                                                * bitmap */
+    const char *name; /* the type's name, for the census */
 };
 
+/* collector statistics */
+struct GGGGC_Stats {
+    ggc_size_t collections; /* number of collections run */
+    ggc_size_t poolCount; /* pools in use */
+    ggc_size_t freePoolCount; /* free pools, still committed */
+    ggc_size_t decommittedPoolCount; /* free pools returned to the OS */
+    ggc_size_t decommittedBytes; /* total bytes ever returned to the OS */
+    ggc_size_t rssBeforeDecommit, rssAfterDecommit; /* resident set size, in
+                                                     * bytes, around the last
+                                                     * decommit (0 if unknown) */
+    ggc_size_t liveBytes; /* what survived the last collection */
+    ggc_size_t heapTargetBytes; /* the heap size allowed until the next */
+
+    /* the pacer's measurements and decisions */
+    ggc_size_t lastPauseNs; /* length of the last collection */
+    ggc_size_t markRate, sweepRate; /* words marked and swept per msec */
+    ggc_size_t allocRate; /* words allocated per msec between collections */
+    ggc_size_t gcCpuPercent; /* share of time spent in the last collection */
+    ggc_size_t predictedPauseNs; /* expected length of the next collection */
+    int pacedBy; /* what chose the heap target (GGGGC_PACED_*) */
+
+    ggc_size_t emergencyCollections; /* collections forced by the heap limit */
+    ggc_size_t idleCollections; /* collections started by GGC_COLLECT_IDLE */
+
+    /* where the time went, in nanoseconds, in the last collection and in all
+     * of them. The pause is the sum of the phases. */
+    ggc_size_t lastRootScanNs, lastMarkNs, lastSweepNs;
+    ggc_size_t totalPauseNs, totalRootScanNs, totalMarkNs, totalSweepNs;
+    ggc_size_t maxPauseNs;
+
+    /* what the last collection found */
+    ggc_size_t markedObjects, markedBytes; /* reached by the mark */
+    ggc_size_t freedObjects, freedBytes; /* newly dead */
+    ggc_size_t freeListEntries, freeListBytes; /* on all pools' free lists */
+    ggc_size_t freeRuns; /* runs of adjacent free objects on them */
+    ggc_size_t largestFreeRunBytes; /* the longest run in any pool */
+    ggc_size_t fragmentationPercent; /* free list outside each pool's longest run */
+    ggc_size_t totalFreedBytes; /* freed by all collections */
+
+    /* allocated since startup */
+    ggc_size_t allocatedObjects, allocatedBytes;
+};
+
+/* what the pacer based the heap target on */
+#define GGGGC_PACED_GROWTH  0 /* the growth percentage and heap bounds */
+#define GGGGC_PACED_PAUSE   1 /* shrunk to meet the pause target */
+#define GGGGC_PACED_CPU     2 /* grown to meet the GC CPU target */
+
 /* pointer stacks are used to assure that pointers on the stack are known */
 struct GGGGC_PointerStack {
     struct GGGGC_PointerStack *next;
@@ -142,17 +220,27 @@ static type ## __descriptorSlotConstructor type ## __descriptorSlotConstructorIn
 
 #endif
 
+/* the pointer layout is a function of the bitmap word, so that types of any
+ * size can be described */
 #define GGC_DESCRIPTOR(type, pointers) \
+    static ggc_size_t type ## __descriptorPointers(ggc_size_t ggggc_word) { \
+        (void) ggggc_word; \
+        return ((ggc_size_t)0) pointers; \
+    } \
     static struct GGGGC_DescriptorSlot type ## __descriptorSlot = { \
         NULL, \
         (sizeof(struct type ## __ggggc_struct) + sizeof(ggc_size_t) - 1) / sizeof(ggc_size_t), \
-        ((ggc_size_t)0) pointers \
+        type ## __descriptorPointers, \
+        #type \
     }; \
     GGGGC_DESCRIPTOR_CONSTRUCTOR(type)
 #define GGGGC_OFFSETOF(type, member) \
     ((ggc_size_t) &((type) 0)->member ## __ptr / sizeof(ggc_size_t))
+#define GGGGC_PTR_BIT(word, offset) \
+    (((offset) / GGGGC_BITS_PER_WORD == (word)) ? \
+        ((ggc_size_t) 1 << ((offset) % GGGGC_BITS_PER_WORD)) : 0)
 #define GGC_PTR(type, member) \
-    | (1<<GGGGC_OFFSETOF(type, member))
+    | GGGGC_PTR_BIT(ggggc_word, GGGGC_OFFSETOF(type, member))
 #define GGC_NO_PTRS | 0
 
 /* macros for defining types 
@@ -218,7 +306,7 @@ static type ## __descriptorSlotConstructor type ## __descriptorSlotConstructorIn
 
 /* write the descriptor user pointer */
 #define GGC_WUP(object, value) do { \
-    struct GGGGC_Descriptor *ggggc_desc = (object)->header.descriptor__ptr; \
+    struct GGGGC_Descriptor *ggggc_desc = GGGGC_DESCRIPTOR_OF(object); \
     GGGGC_ASSERT_ID(object); \
     GGGGC_WP(ggggc_desc, user__ptr, value); \
 } while(0)
@@ -228,7 +316,7 @@ static type ## __descriptorSlotConstructor type ## __descriptorSlotConstructorIn
 #define GGC_RD(object, member)  ((object)->member ## __data)
 #define GGC_RAP(object, index)  ((object)->a__ptrs[(index)])
 #define GGC_RAD(object, index)  ((object)->a__data[(index)])
-#define GGC_RUP(object)         ((object)->header.descriptor__ptr->user__ptr)
+#define GGC_RUP(object)         (GGGGC_DESCRIPTOR_OF(object)->user__ptr)
 #define GGC_LENGTH(object)      ((object)->header.descriptor__ptr->length)
 
 /* because the write barrier forces you to use identifiers, an identifier version of NULL */
@@ -248,6 +336,29 @@ void *ggggc_mallocSlot(struct GGGGC_DescriptorSlot *slot);
 #define GGC_NEW(type) ((type) ggggc_mallocSlot(&type ## __descriptorSlot))
 #endif
 
+/* the same allocators, but returning NULL instead of aborting if the heap is
+ * exhausted (see GGC_SET_OOM_HANDLER) */
+void *ggggc_tryMalloc(struct GGGGC_Descriptor *descriptor);
+void *ggggc_tryMallocSlot(struct GGGGC_DescriptorSlot *slot);
+void *ggggc_tryMallocPointerArray(ggc_size_t sz);
+void *ggggc_tryMallocDataArray(ggc_size_t nmemb, ggc_size_t size);
+#ifdef GGGGC_DESCRIPTORS_CONSTRUCTED
+#define GGC_TRY_NEW(type) ((type) ggggc_tryMalloc(type ## __descriptorSlot.descriptor))
+#else
+#define GGC_TRY_NEW(type) ((type) ggggc_tryMallocSlot(&type ## __descriptorSlot))
+#endif
+#define GGC_TRY_NEW_PA(type, size) \
+    ((type ## Array) ggggc_tryMallocPointerArray((size)))
+#define GGC_TRY_NEW_DA(type, size) \
+    ((GGC_ ## type ## _Array) ggggc_tryMallocDataArray((size), sizeof(type)))
+
+/* set the function called when an allocation doesn't fit in the heap even
+ * after an emergency collection. It's told how many bytes were requested, and
+ * may free what it can (e.g. drop caches) or raise the heap limit, then return
+ * nonzero to collect and retry, or 0 to fail the allocation. */
+void ggggc_setOOMHandler(int (*handler)(ggc_size_t bytes));
+#define GGC_SET_OOM_HANDLER(handler) ggggc_setOOMHandler(handler)
+
 /* allocate a pointer array (size is in words) */
 void *ggggc_mallocPointerArray(ggc_size_t sz);
 #define GGC_NEW_PA(type, size) \
@@ -281,6 +392,214 @@ struct GGGGC_Descriptor *ggggc_allocateDescriptorSlot(struct GGGGC_DescriptorSlo
 int ggggc_yield(void);
 #define GGC_YIELD() ggggc_yield()
 
+/* get a snapshot of the collector's statistics */
+void ggggc_getStats(struct GGGGC_Stats *stats);
+#define GGC_GET_STATS(stats) ggggc_getStats(stats)
+
+/* runtime configuration. Everything else (pool size, allocator, debugging) is
+ * chosen at compile time. */
+struct GGGGC_Config {
+    ggc_size_t heapMin, heapMax; /* heap bounds in bytes (max 0 for none) */
+    ggc_size_t heapLimit; /* hard limit in bytes (0 for none) */
+    unsigned growthPercent; /* heap growth over the live size */
+    ggc_size_t pauseTargetUs; /* pacer pause target (0 for none) */
+    unsigned gcCpuPercent; /* pacer GC CPU target (0 for none) */
+    int hugePages; /* 0 for normal pages, 1 for transparent, 2 for explicit */
+    ggc_size_t decommitDelay; /* collections before free pools are released */
+    ggc_size_t retainedPools; /* free pools never released */
+    int reportStats; /* print statistics to stderr at exit */
+    const char *traceFile; /* trace to this file (NULL for no tracing) */
+    int censusSignal; /* take a census on this signal (0 for none) */
+    ggc_size_t profileRate; /* sample allocations about once per this many
+                             * bytes (0 for no profiling) */
+    const char *profileFile; /* write the allocation profile here at exit */
+    const char *metricsName; /* publish metrics in this shared memory segment
+                              * ("" for the default, NULL for none) */
+    int counters; /* count hardware events in each phase */
+};
+
+/* get the configuration in effect (the compile-time defaults, until changed) */
+void ggggc_getConfig(struct GGGGC_Config *config);
+#define GGC_GET_CONFIG(config) ggggc_getConfig(config)
+
+/* configure the collector. The given configuration (or the current one, if
+ * NULL) is overridden by any GGGGC_* environment variables of the same names,
+ * e.g. GGGGC_HEAP_MAX=2G. Calling this is optional; it's called with NULL on
+ * the first allocation otherwise. */
+void ggggc_init(const struct GGGGC_Config *config);
+#define GGC_INIT(config) ggggc_init(config)
+
+/* set the heap policy: the next collection happens once the heap has grown
+ * by growthPercent over what survived the last one, but the heap is always
+ * allowed minBytes, and never more than maxBytes (0 for no maximum) */
+void ggggc_setHeapPolicy(ggc_size_t minBytes, ggc_size_t maxBytes, unsigned growthPercent);
+#define GGC_SET_HEAP_POLICY(minBytes, maxBytes, growthPercent) \
+    ggggc_setHeapPolicy((minBytes), (maxBytes), (growthPercent))
+
+/* set the pacer's targets: the heap is grown beyond the heap policy when
+ * collections would otherwise take more than cpuPercent of the time, and
+ * shrunk (never below what's live) when the next collection is predicted to
+ * pause for more than maxPauseUs. 0 disables either target. */
+void ggggc_setPacer(ggc_size_t maxPauseUs, unsigned cpuPercent);
+#define GGC_SET_PACER(maxPauseUs, cpuPercent) \
+    ggggc_setPacer((maxPauseUs), (cpuPercent))
+
+/* run a full collection now */
+void ggggc_collect();
+#define GGC_COLLECT() ggggc_collect()
+
+/* do collection work in idle time, taking about budgetUs microseconds at
+ * most. If enough has been allocated to make it worthwhile and the mark is
+ * predicted to fit, a collection is started, and as much of its sweep as fits
+ * is done; the rest is done by later idle calls or as allocation reaches each
+ * pool. Returns nonzero if sweeping is still left to do. */
+int ggggc_collectIdle(ggc_size_t budgetUs);
+#define GGC_COLLECT_IDLE(budgetUs) ggggc_collectIdle(budgetUs)
+
+/* the pause length, in nanoseconds, which the given fraction (0 to 1) of
+ * pauses didn't exceed, e.g. GGC_PAUSE_PERCENTILE(0.99) for p99 */
+ggc_size_t ggggc_pausePercentile(double fraction);
+#define GGC_PAUSE_PERCENTILE(fraction) ggggc_pausePercentile(fraction)
+
+/* the minimum mutator utilization (0 to 1) over any window of the given
+ * length, across recent pauses */
+double ggggc_mmu(ggc_size_t windowUs);
+#define GGC_MMU(windowUs) ggggc_mmu(windowUs)
+
+/* print the pause distribution and MMU to stderr */
+void ggggc_reportPauses(void);
+#define GGC_REPORT_PAUSES() ggggc_reportPauses()
+
+/* trace the collector's phases to a file in Chrome trace-event format, for
+ * chrome://tracing or Perfetto. Events are buffered in memory, keeping only
+ * the most recent, and written out by GGC_TRACE_FLUSH or at exit. */
+void ggggc_traceStart(const char *path);
+#define GGC_TRACE_START(path) ggggc_traceStart(path)
+void ggggc_traceFlush(void);
+#define GGC_TRACE_FLUSH() ggggc_traceFlush()
+
+/* a census of the live heap: objects and bytes of each type. Types are named
+ * by GGC_TYPE; everything else is grouped by kind. */
+struct GGGGC_CensusEntry {
+    const char *name;
+    ggc_size_t objects, bytes;
+};
+
+/* collect, taking a census while sweeping, and store up to max entries,
+ * largest first. Returns the number of entries in the full census. */
+ggc_size_t ggggc_census(struct GGGGC_CensusEntry *entries, ggc_size_t max);
+#define GGC_CENSUS(entries, max) ggggc_census((entries), (max))
+
+/* print the last census to stderr */
+void ggggc_reportCensus(void);
+#define GGC_REPORT_CENSUS() ggggc_reportCensus()
+
+/* take a census at the next allocation after the given signal, and print it
+ * to stderr */
+void ggggc_censusOnSignal(int signum);
+#define GGC_CENSUS_ON_SIGNAL(signum) ggggc_censusOnSignal(signum)
+
+/* the free list of a pool after the last sweep. Allocation only reuses a
+ * free object of exactly the size asked for, so the size classes show what
+ * it can be reused for, and the runs what coalescing could make of it. */
+struct GGGGC_PoolFragmentation {
+    void *pool;
+    ggc_size_t freeBytes, largestRunBytes, runs, entries;
+    ggc_size_t sizeClasses[GGGGC_SIZE_CLASSES]; /* entries of 2^i to 2^(i+1)-1 words */
+};
+
+/* finish any sweep in progress, and store up to max pools' free lists.
+ * Returns the number of pools. */
+ggc_size_t ggggc_fragmentation(struct GGGGC_PoolFragmentation *pools,
+    ggc_size_t max);
+#define GGC_FRAGMENTATION(pools, max) ggggc_fragmentation((pools), (max))
+
+/* print each pool's free list and the heap's fragmentation to stderr */
+void ggggc_reportFragmentation(void);
+#define GGC_REPORT_FRAGMENTATION() ggggc_reportFragmentation()
+
+/* keep the collector's counters in a POSIX shared memory segment with the
+ * given name (NULL for /ggggc.<pid>), laid out as in ggggc/metrics.h, for
+ * tools/ggggc-top or anything else to read. Returns 0 if it couldn't be
+ * created. */
+int ggggc_metricsPublish(const char *name);
+#define GGC_METRICS_PUBLISH(name) ggggc_metricsPublish(name)
+
+/* hardware event counts in each phase of collection, from perf_event_open */
+struct GGGGC_Counters {
+    unsigned long long cycles, instructions;
+    unsigned long long l1dMisses, llcMisses, dtlbMisses; /* on reads */
+};
+#define GGGGC_COUNTER_UNAVAILABLE ((unsigned long long) -1)
+
+/* start counting. Returns the number of counters the system has (0 if none,
+ * or perf events aren't allowed), any others being GGGGC_COUNTER_UNAVAILABLE */
+int ggggc_countersStart(void);
+#define GGC_COUNTERS_START() ggggc_countersStart()
+
+/* get the counts of the mark (with the root scan) and the sweep, across all
+ * collections. Returns 0 if not counting. */
+int ggggc_counters(struct GGGGC_Counters *mark, struct GGGGC_Counters *sweep);
+#define GGC_COUNTERS(mark, sweep) ggggc_counters((mark), (sweep))
+
+/* print the counts to stderr */
+void ggggc_reportCounters(void);
+#define GGC_REPORT_COUNTERS() ggggc_reportCounters()
+
+/* sample allocations about once per rate bytes, recording the call stack and
+ * type of each sample and whether it's still alive (0 to stop sampling) */
+void ggggc_profileStart(ggc_size_t rate);
+#define GGC_PROFILE_START(rate) ggggc_profileStart(rate)
+
+/* write the allocation profile in pprof's legacy heap format. Returns 0 if
+ * the file couldn't be written. */
+int ggggc_profileWrite(const char *path);
+#define GGC_PROFILE_WRITE(path) ggggc_profileWrite(path)
+
+/* print the call stacks retaining the most to stderr */
+void ggggc_reportProfile(void);
+#define GGC_REPORT_PROFILE() ggggc_reportProfile()
+
+/* while profiling, the fraction of the sampled objects of the given type (or
+ * all types, if NULL) which lived past the given age, in bytes allocated, or
+ * -1 if the profile isn't that old */
+double ggggc_survival(const char *type, ggc_size_t age);
+#define GGC_SURVIVAL(type, age) ggggc_survival((type), (age))
+
+/* print each type's survival curve to stderr */
+void ggggc_reportLifetimes(void);
+#define GGC_REPORT_LIFETIMES() ggggc_reportLifetimes()
+
+/* collect, then write every object, its pointers and the roots to the given
+ * file, in the format described in ggggc/dump.h. Returns 0 if the file
+ * couldn't be written. */
+int ggggc_dumpHeap(const char *path);
+#define GGC_DUMP_HEAP(path) ggggc_dumpHeap(path)
+
+/* snapshots of the live heap by type and retention path (the types of the
+ * objects through which each object was first reached, back to its root),
+ * for finding what's growing without dumping the heap */
+struct GGGGC_SnapshotDelta {
+    const char *type, *path;
+    long objects, bytes;
+};
+
+/* collect, counting the live objects on each retention path. The last
+ * snapshot is kept to compare against. */
+void ggggc_snapshot(void);
+#define GGC_SNAPSHOT() ggggc_snapshot()
+
+/* store up to max retention paths which grew between the last two snapshots,
+ * largest growth first. Returns the number which grew. */
+ggc_size_t ggggc_snapshotDiff(struct GGGGC_SnapshotDelta *deltas,
+    ggc_size_t max);
+#define GGC_SNAPSHOT_DIFF(deltas, max) ggggc_snapshotDiff((deltas), (max))
+
+/* print how each type changed, and the retention paths which grew, to
+ * stderr */
+void ggggc_reportSnapshotDiff(void);
+#define GGC_REPORT_SNAPSHOT_DIFF() ggggc_reportSnapshotDiff()
+
 /* to handle global variables, GGC_PUSH them then GGC_GLOBALIZE */
 void ggggc_globalize(void);
 #define GGC_GLOBALIZE() ggggc_globalize()
@@ -0,0 +1,93 @@
+/*
+ * GGGGC shared memory metrics format
+ *
+ * Copyright (c) 2014, 2015 Gregor Richards
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION
+ * OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef GGGGC_METRICS_H
+#define GGGGC_METRICS_H 1
+
+/* With GGC_METRICS_PUBLISH, the collector keeps its counters in a POSIX
+ * shared memory segment laid out as struct GGGGC_Metrics, so that another
+ * process can watch them. Every counter is 64 bits, so a reader needn't share
+ * the writer's word size. The writer makes the sequence odd before changing
+ * anything and even again after, so a reader should copy the segment until it
+ * gets the same, even sequence before and after the copy (see
+ * GGGGC_METRICS_READ). A writer killed mid-update leaves the sequence odd. Fields are only ever added at the end, with size
+ * telling how many there are; version changes if their meaning does. */
+#define GGGGC_METRICS_MAGIC "GGGGCMS\n"
+#define GGGGC_METRICS_VERSION 1
+
+/* the default segment name is this followed by the process ID */
+#define GGGGC_METRICS_PREFIX "/ggggc."
+
+/* pause histogram bucket i counts pauses of 2^i to 2^(i+1)-1 microseconds,
+ * except bucket 0, which also counts those under a microsecond */
+#define GGGGC_METRICS_PAUSE_BUCKETS 32
+
+struct GGGGC_Metrics {
+    char magic[8];
+    unsigned int version, size; /* size is that of the whole struct, in bytes */
+    volatile unsigned long long sequence;
+
+    unsigned long long pid;
+    unsigned long long updatedNs; /* monotonic clock at the last update */
+
+    /* as of the last collection */
+    unsigned long long collections;
+    unsigned long long heapBytes; /* in pools */
+    unsigned long long heapTargetBytes;
+    unsigned long long liveBytes;
+    unsigned long long poolCount;
+    unsigned long long allocatedBytes; /* since startup */
+    unsigned long long allocRate; /* bytes per second between collections */
+
+    /* every pause */
+    unsigned long long pauses;
+    unsigned long long lastPauseNs, maxPauseNs, totalPauseNs;
+    unsigned long long pauseHistogram[GGGGC_METRICS_PAUSE_BUCKETS];
+};
+
+#if defined(__GNUC__) && !defined(GGGGC_NO_GNUC_FEATURES)
+#define GGGGC_METRICS_BARRIER() __sync_synchronize()
+#else
+#define GGGGC_METRICS_BARRIER()
+#endif
+
+/* how many times a reader tries for a consistent copy before giving up, e.g.
+ * because the writer died halfway through an update */
+#ifndef GGGGC_METRICS_READ_TRIES
+#define GGGGC_METRICS_READ_TRIES 1000000
+#endif
+
+/* copy a consistent view of the segment into a struct GGGGC_Metrics, setting
+ * ok to whether that worked */
+#define GGGGC_METRICS_READ(to, from, ok) do { \
+    unsigned long long ggggc_seq_; \
+    unsigned long ggggc_tries_ = GGGGC_METRICS_READ_TRIES; \
+    (ok) = 0; \
+    while (ggggc_tries_--) { \
+        if ((ggggc_seq_ = (from)->sequence) & 1) continue; \
+        GGGGC_METRICS_BARRIER(); \
+        memcpy((to), (const void *) (from), sizeof(struct GGGGC_Metrics)); \
+        GGGGC_METRICS_BARRIER(); \
+        if ((from)->sequence == ggggc_seq_) { \
+            (ok) = 1; \
+            break; \
+        } \
+    } \
+} while (0)
+
+#endif
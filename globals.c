@@ -4,9 +4,26 @@
 struct GGGGC_PointerStack *ggggc_pointerStack, *ggggc_pointerStackGlobals;
 
 /* internals */
+struct GGGGC_PointerStack *ggggc_pointerStackGlobalsStart;
 struct GGGGC_Pool *ggggc_poolList;
 struct GGGGC_Pool *ggggc_curPool;
 
-struct GGGGC_Descriptor *ggggc_descriptorDescriptors[GGGGC_WORDS_PER_POOL/GGGGC_BITS_PER_WORD+sizeof(struct GGGGC_Descriptor)];
+struct GGGGC_Descriptor *ggggc_descriptorDescriptors[GGGGC_DESCRIPTOR_DESCRIPTORS];
 ggc_size_t ggggc_poolCount;
 int ggggc_forceCollect;
+ggc_size_t ggggc_markEpoch = 1;
+ggc_size_t ggggc_decommitDelay = GGGGC_DECOMMIT_DELAY;
+ggc_size_t ggggc_retainedPools = GGGGC_RETAINED_POOLS;
+int ggggc_hugePages = GGGGC_HUGE_PAGES;
+unsigned char *ggggc_heapBase, *ggggc_heapTop;
+ggc_size_t ggggc_heapMin = GGGGC_HEAP_MIN / sizeof(ggc_size_t);
+ggc_size_t ggggc_heapMax = GGGGC_HEAP_MAX / sizeof(ggc_size_t);
+unsigned ggggc_growthPercent = GGGGC_GROWTH_PERCENT;
+ggc_size_t ggggc_heapLimit = GGGGC_HEAP_LIMIT / sizeof(ggc_size_t);
+int (*ggggc_oomHandler)(ggc_size_t bytes);
+ggc_size_t ggggc_allocatedWords, ggggc_collectThreshold;
+ggc_size_t ggggc_pauseTarget = (ggc_size_t) GGGGC_PAUSE_TARGET_US * 1000;
+unsigned ggggc_gcCpuPercent = GGGGC_GC_CPU_PERCENT;
+double ggggc_markRate, ggggc_sweepRate, ggggc_allocRate;
+int ggggc_initialized, ggggc_reportStats;
+struct GGGGC_Stats ggggc_stats;
@@ -0,0 +1,178 @@
+/*
+ * Shared memory metrics
+ *
+ * Copyright (c) 2014, 2015 Gregor Richards
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION
+ * OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+
+/* for standards info */
+#if defined(unix) || defined(__unix) || defined(__unix__) || \
+    (defined(__APPLE__) && defined(__MACH__))
+#include <unistd.h>
+#endif
+
+#if _POSIX_SHARED_MEMORY_OBJECTS > 0
+#include <fcntl.h>
+#include <sys/mman.h>
+#endif
+
+#include "ggggc/gc.h"
+#include "ggggc/metrics.h"
+#include "ggggc-internals.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* the published segment, if any */
+struct GGGGC_Metrics *ggggc_metrics;
+static char metricsName[256];
+
+/* unlink the segment, so it goes away once no reader has it open */
+static void metricsUnlink(void)
+{
+#if _POSIX_SHARED_MEMORY_OBJECTS > 0
+    if (ggggc_metrics) shm_unlink(metricsName);
+#endif
+}
+
+int ggggc_metricsPublish(const char *name)
+{
+#if _POSIX_SHARED_MEMORY_OBJECTS > 0
+    static int unlinking = 0;
+    struct GGGGC_Metrics *metrics;
+    char defaultName[64];
+    int fd;
+
+    if (!name || !name[0]) {
+        sprintf(defaultName, GGGGC_METRICS_PREFIX "%lu",
+            (unsigned long) getpid());
+        name = defaultName;
+    }
+    if (ggggc_metrics && !strcmp(name, metricsName)) return 1;
+    if (strlen(name) >= sizeof(metricsName)) {
+        fprintf(stderr, "GGGGC: metrics segment name too long: %s\n", name);
+        return 0;
+    }
+
+    fd = shm_open(name, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        perror(name);
+        return 0;
+    }
+    if (ftruncate(fd, sizeof(struct GGGGC_Metrics)) < 0) {
+        perror(name);
+        close(fd);
+        shm_unlink(name);
+        return 0;
+    }
+    metrics = (struct GGGGC_Metrics *) mmap(NULL,
+        sizeof(struct GGGGC_Metrics), PROT_READ | PROT_WRITE, MAP_SHARED, fd,
+        0);
+    close(fd);
+    if (metrics == (struct GGGGC_Metrics *) MAP_FAILED) {
+        perror(name);
+        shm_unlink(name);
+        return 0;
+    }
+
+    /* only one segment at a time */
+    if (ggggc_metrics) {
+        metricsUnlink();
+        munmap(ggggc_metrics, sizeof(struct GGGGC_Metrics));
+    }
+    strcpy(metricsName, name);
+
+    /* the magic goes in last, so a reader never sees half a header */
+    metrics->version = GGGGC_METRICS_VERSION;
+    metrics->size = sizeof(struct GGGGC_Metrics);
+    metrics->pid = (unsigned long long) getpid();
+    GGGGC_METRICS_BARRIER();
+    memcpy(metrics->magic, GGGGC_METRICS_MAGIC, sizeof(metrics->magic));
+    ggggc_metrics = metrics;
+    ggggc_metricsUpdate();
+
+    if (!unlinking) {
+        unlinking = 1;
+        atexit(metricsUnlink);
+    }
+    return 1;
+
+#else
+    (void) name;
+    fprintf(stderr, "GGGGC: shared memory metrics aren't supported here\n");
+    return 0;
+
+#endif
+}
+
+/* seqlock writes: odd while the segment is inconsistent */
+static void beginWrite(void)
+{
+    ggggc_metrics->sequence++;
+    GGGGC_METRICS_BARRIER();
+}
+
+static void endWrite(void)
+{
+    ggggc_metrics->updatedNs = ggggc_now();
+    GGGGC_METRICS_BARRIER();
+    ggggc_metrics->sequence++;
+}
+
+/* publish the counters, after a collection */
+void ggggc_metricsUpdate()
+{
+    struct GGGGC_Metrics *m = ggggc_metrics;
+    struct GGGGC_Stats stats;
+
+    ggggc_getStats(&stats);
+    beginWrite();
+    m->collections = stats.collections;
+    m->heapBytes = (unsigned long long) stats.poolCount * GGGGC_POOL_BYTES;
+    m->heapTargetBytes = stats.heapTargetBytes;
+    m->liveBytes = stats.liveBytes;
+    m->poolCount = stats.poolCount;
+    m->allocatedBytes = stats.allocatedBytes;
+    m->allocRate = (unsigned long long) stats.allocRate *
+        sizeof(ggc_size_t) * 1000;
+    endWrite();
+}
+
+/* publish a pause */
+void ggggc_metricsPause(ggc_size_t ns)
+{
+    struct GGGGC_Metrics *m = ggggc_metrics;
+    ggc_size_t us = ns / 1000;
+    int bucket = 0;
+
+    while ((us >>= 1) && bucket < GGGGC_METRICS_PAUSE_BUCKETS - 1) bucket++;
+
+    beginWrite();
+    m->pauses++;
+    m->lastPauseNs = ns;
+    if (ns > m->maxPauseNs) m->maxPauseNs = ns;
+    m->totalPauseNs += ns;
+    m->pauseHistogram[bucket]++;
+    endWrite();
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,165 @@
+/*
+ * Pause time histogram and minimum mutator utilization
+ *
+ * Copyright (c) 2014, 2015 Gregor Richards
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION
+ * OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/types.h>
+
+#include "ggggc/gc.h"
+#include "ggggc-internals.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Pauses are counted in a log-linear histogram, as in HdrHistogram: each
+ * power of two is split into 2^GGGGC_PAUSE_SUB_BITS buckets, so every
+ * bucket is within about 6% of the pauses counted in it, from nanoseconds to
+ * as long as anyone could wait. */
+#define GGGGC_PAUSE_SUB_BITS 4
+#define GGGGC_PAUSE_SUBS (1 << GGGGC_PAUSE_SUB_BITS)
+#define GGGGC_PAUSE_BUCKETS (GGGGC_BITS_PER_WORD * GGGGC_PAUSE_SUBS)
+
+static ggc_size_t histogram[GGGGC_PAUSE_BUCKETS];
+static ggc_size_t pauseCount;
+
+/* and the most recent pauses are kept for MMU */
+static struct {
+    ggc_size_t start, end;
+} history[GGGGC_PAUSE_HISTORY];
+static ggc_size_t historyNext;
+
+static ggc_size_t bucketOf(ggc_size_t ns)
+{
+    int bits;
+    if (ns < GGGGC_PAUSE_SUBS) return ns;
+    bits = GGGGC_MSB(ns) - GGGGC_PAUSE_SUB_BITS;
+    return (bits + 1) * GGGGC_PAUSE_SUBS +
+        ((ns >> bits) & (GGGGC_PAUSE_SUBS - 1));
+}
+
+/* the largest pause counted in a bucket */
+static ggc_size_t bucketMax(ggc_size_t bucket)
+{
+    ggc_size_t bits;
+    if (bucket < GGGGC_PAUSE_SUBS) return bucket;
+    bits = bucket / GGGGC_PAUSE_SUBS - 1;
+    return ((GGGGC_PAUSE_SUBS + bucket % GGGGC_PAUSE_SUBS + 1) << bits) - 1;
+}
+
+/* record a pause */
+void ggggc_recordPause(ggc_size_t start, ggc_size_t end)
+{
+    histogram[bucketOf(end - start)]++;
+    pauseCount++;
+    if (ggggc_metrics) ggggc_metricsPause(end - start);
+    history[historyNext % GGGGC_PAUSE_HISTORY].start = start;
+    history[historyNext % GGGGC_PAUSE_HISTORY].end = end;
+    historyNext++;
+}
+
+/* the pause length which the given fraction of pauses didn't exceed */
+ggc_size_t ggggc_pausePercentile(double fraction)
+{
+    ggc_size_t want, seen, i;
+
+    if (!pauseCount) return 0;
+    want = (ggc_size_t) (fraction * pauseCount);
+    if (want >= pauseCount) want = pauseCount - 1;
+
+    seen = 0;
+    for (i = 0; i < GGGGC_PAUSE_BUCKETS; i++) {
+        seen += histogram[i];
+        if (seen > want) return bucketMax(i);
+    }
+    return bucketMax(GGGGC_PAUSE_BUCKETS - 1);
+}
+
+/* how much of the given window is spent in pauses */
+static ggc_size_t pausedIn(ggc_size_t from, ggc_size_t to, ggc_size_t first)
+{
+    ggc_size_t i, ret = 0;
+    for (i = first; i < historyNext; i++) {
+        ggc_size_t s = history[i % GGGGC_PAUSE_HISTORY].start;
+        ggc_size_t e = history[i % GGGGC_PAUSE_HISTORY].end;
+        if (s >= to) break;
+        if (e <= from) continue;
+        if (s < from) s = from;
+        if (e > to) e = to;
+        ret += e - s;
+    }
+    return ret;
+}
+
+/* the minimum mutator utilization over windows of the given length, across
+ * the recent pauses */
+double ggggc_mmu(ggc_size_t windowUs)
+{
+    ggc_size_t window = windowUs * 1000;
+    ggc_size_t first, i, worst = 0;
+
+    if (!historyNext || !window) return 1;
+    first = (historyNext > GGGGC_PAUSE_HISTORY) ?
+        historyNext - GGGGC_PAUSE_HISTORY : 0;
+
+    /* the worst window always starts at the start of a pause or ends at the
+     * end of one */
+    for (i = first; i < historyNext; i++) {
+        ggc_size_t s = history[i % GGGGC_PAUSE_HISTORY].start;
+        ggc_size_t e = history[i % GGGGC_PAUSE_HISTORY].end;
+        ggc_size_t paused;
+
+        paused = pausedIn(s, s + window, first);
+        if (paused > worst) worst = paused;
+        if (e >= window) {
+            paused = pausedIn(e - window, e, first);
+            if (paused > worst) worst = paused;
+        }
+    }
+
+    if (worst >= window) return 0;
+    return 1 - (double) worst / window;
+}
+
+/* print the pause distribution and MMU to stderr */
+void ggggc_reportPauses()
+{
+    static const ggc_size_t windows[] = {1000, 10000, 100000, 1000000};
+    ggc_size_t i;
+
+    if (!pauseCount) return;
+
+    fprintf(stderr, "GGGGC: %lu pauses: p50 %lu usec, p90 %lu, p99 %lu, "
+                    "p99.9 %lu, max %lu\n",
+        (unsigned long) pauseCount,
+        (unsigned long) ggggc_pausePercentile(0.5) / 1000,
+        (unsigned long) ggggc_pausePercentile(0.9) / 1000,
+        (unsigned long) ggggc_pausePercentile(0.99) / 1000,
+        (unsigned long) ggggc_pausePercentile(0.999) / 1000,
+        (unsigned long) ggggc_pausePercentile(1) / 1000);
+
+    fprintf(stderr, "GGGGC: MMU:");
+    for (i = 0; i < sizeof(windows) / sizeof(windows[0]); i++)
+        fprintf(stderr, " %lums %.1f%%",
+            (unsigned long) windows[i] / 1000, ggggc_mmu(windows[i]) * 100);
+    fprintf(stderr, "\n");
+}
+
+#ifdef __cplusplus
+}
+#endif
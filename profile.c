@@ -0,0 +1,514 @@
+/*
+ * Sampling allocation profiler
+ *
+ * Copyright (c) 2014, 2015 Gregor Richards
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION
+ * OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+
+#if defined(__GLIBC__) || (defined(__APPLE__) && defined(__MACH__))
+#define GGGGC_PROFILE_BACKTRACE 1
+#include <execinfo.h>
+#endif
+
+#include "ggggc/gc.h"
+#include "ggggc-internals.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* As in tcmalloc, the distance between samples is drawn from an exponential
+ * distribution with the sampling rate as its mean, so every byte is equally
+ * likely to be sampled however the allocations line up. An object of s bytes
+ * is then sampled with probability 1 - e^(-s/rate), so each sample stands for
+ * s / (1 - e^(-s/rate)) bytes of allocation: about the rate for small objects,
+ * and about their own size for large ones.
+ *
+ * Time is measured in bytes allocated, so each sample remembers how much had
+ * been allocated when it was, and when it dies its lifetime goes into a log2
+ * histogram for its type. */
+
+/* the lifetimes of a type's samples, bucketed by the log2 of their age in
+ * bytes allocated */
+struct GGGGC_ProfileLifetimes {
+    struct GGGGC_ProfileLifetimes *next;
+    const char *type;
+    ggc_size_t died[GGGGC_BITS_PER_WORD];
+};
+
+/* a distinct call stack and type */
+struct GGGGC_ProfileStack {
+    ggc_size_t hash;
+    const char *type;
+    struct GGGGC_ProfileLifetimes *lifetimes;
+    int depth;
+    void *pcs[GGGGC_PROFILE_DEPTH];
+
+    /* as sampled */
+    ggc_size_t allocs, allocBytes, live, liveBytes;
+
+    /* and as estimated */
+    ggc_size_t allocEstimate, liveEstimate;
+};
+
+/* a sampled object which hasn't died yet */
+struct GGGGC_ProfileSample {
+    void *obj;
+    struct GGGGC_ProfileStack *stack;
+    ggc_size_t bytes, estimate, born;
+};
+
+ggc_size_t ggggc_profileLeft = (ggc_size_t) -1;
+ggc_size_t ggggc_profileRate;
+static ggc_size_t profileStartTime, profileStartBytes;
+static unsigned long long profileRandom = 1;
+
+/* all the stacks, in an open-addressed hash table */
+static struct GGGGC_ProfileStack **stacks;
+static ggc_size_t stacksSize, stacksUsed;
+
+/* and the living samples */
+static struct GGGGC_ProfileSample *samples;
+static ggc_size_t samplesSize, samplesUsed;
+
+/* and the dead, by type */
+static struct GGGGC_ProfileLifetimes *lifetimes;
+
+/* bytes allocated so far */
+static ggc_size_t allocatedNow()
+{
+    return ggggc_stats.allocatedBytes +
+        ggggc_allocatedWords * sizeof(ggc_size_t);
+}
+
+static struct GGGGC_ProfileLifetimes *lifetimesFor(const char *type)
+{
+    struct GGGGC_ProfileLifetimes *lt;
+    for (lt = lifetimes; lt; lt = lt->next)
+        if (lt->type == type) return lt;
+
+    lt = (struct GGGGC_ProfileLifetimes *)
+        calloc(1, sizeof(struct GGGGC_ProfileLifetimes));
+    if (!lt) {
+        perror("calloc");
+        abort();
+    }
+    lt->type = type;
+    lt->next = lifetimes;
+    return lifetimes = lt;
+}
+
+/* the natural log of a positive integer, without needing libm */
+static double logOf(ggc_size_t v)
+{
+    int e = 0;
+    double m, y, y2;
+
+    while (v >> (e + 1)) e++;
+    m = (double) v / ((ggc_size_t) 1 << e);
+
+    /* ln m = 2 atanh((m-1)/(m+1)), and m is in [1, 2) */
+    y = (m - 1) / (m + 1);
+    y2 = y * y;
+    return e * 0.69314718055994531 +
+        2 * y * (1 + y2 * (1.0/3 + y2 * (1.0/5 + y2 * (1.0/7 + y2 / 9))));
+}
+
+/* e^-x for x >= 0, also without libm */
+static double expNeg(double x)
+{
+    int halvings = 0, i;
+    double term = 1, ret = 1;
+
+    if (x > 40) return 0;
+
+    /* e^-x = (e^(-x/2^k))^(2^k), with x/2^k small enough for a short series */
+    while (x > 0.5) {
+        x /= 2;
+        halvings++;
+    }
+    for (i = 1; i <= 10; i++) {
+        term *= -x / i;
+        ret += term;
+    }
+    while (halvings--) ret *= ret;
+    return ret;
+}
+
+/* the number of words until the next sample */
+static ggc_size_t nextSample()
+{
+    ggc_size_t q, bytes;
+
+    /* 48-bit LCG, as in drand48; the top 26 bits are plenty */
+    profileRandom = (profileRandom * 0x5DEECE66DULL + 0xB) &
+        ((1ULL << 48) - 1);
+    q = (ggc_size_t) (profileRandom >> 22) + 1;
+
+    /* -ln(q / 2^26) * rate */
+    bytes = (ggc_size_t)
+        ((26 * 0.69314718055994531 - logOf(q)) * ggggc_profileRate);
+    bytes /= sizeof(ggc_size_t);
+    return bytes ? bytes : 1;
+}
+
+static struct GGGGC_ProfileStack **stackSlot(ggc_size_t hash, const char *type,
+    int depth, void **pcs)
+{
+    ggc_size_t i = hash & (stacksSize - 1);
+    struct GGGGC_ProfileStack *stack;
+    while ((stack = stacks[i])) {
+        if (stack->hash == hash && stack->type == type &&
+            stack->depth == depth &&
+            !memcmp(stack->pcs, pcs, depth * sizeof(void *)))
+            break;
+        i = (i + 1) & (stacksSize - 1);
+    }
+    return &stacks[i];
+}
+
+static void growStacks(ggc_size_t size)
+{
+    struct GGGGC_ProfileStack **old = stacks;
+    ggc_size_t oldSize = stacksSize, i;
+
+    stacks = (struct GGGGC_ProfileStack **)
+        calloc(size, sizeof(struct GGGGC_ProfileStack *));
+    if (!stacks) {
+        perror("calloc");
+        abort();
+    }
+    stacksSize = size;
+
+    for (i = 0; i < oldSize; i++) {
+        struct GGGGC_ProfileStack *stack = old[i];
+        if (stack)
+            *stackSlot(stack->hash, stack->type, stack->depth, stack->pcs) =
+                stack;
+    }
+    free(old);
+}
+
+/* find or make the record for this stack */
+static struct GGGGC_ProfileStack *stackFor(const char *type, int depth,
+    void **pcs)
+{
+    struct GGGGC_ProfileStack **slot, *stack;
+    ggc_size_t hash = (ggc_size_t) type;
+    int i;
+
+    for (i = 0; i < depth; i++)
+        hash = (hash ^ (ggc_size_t) pcs[i]) * (ggc_size_t) 0x100000001B3ULL;
+
+    if (!stacks) growStacks(256);
+    slot = stackSlot(hash, type, depth, pcs);
+    if (*slot) return *slot;
+
+    if ((stacksUsed + 1) * 2 > stacksSize) {
+        growStacks(stacksSize * 2);
+        slot = stackSlot(hash, type, depth, pcs);
+    }
+
+    stack = (struct GGGGC_ProfileStack *)
+        calloc(1, sizeof(struct GGGGC_ProfileStack));
+    if (!stack) {
+        perror("calloc");
+        abort();
+    }
+    stack->hash = hash;
+    stack->type = type;
+    stack->lifetimes = lifetimesFor(type);
+    stack->depth = depth;
+    memcpy(stack->pcs, pcs, depth * sizeof(void *));
+    stacksUsed++;
+    return *slot = stack;
+}
+
+/* sample this allocation */
+void ggggc_profileSample(void *obj, struct GGGGC_Descriptor *descriptor)
+{
+    void *pcs[GGGGC_PROFILE_DEPTH + 1];
+    int depth = 0;
+    struct GGGGC_ProfileStack *stack;
+    struct GGGGC_ProfileSample *sample;
+    ggc_size_t bytes = descriptor->size * sizeof(ggc_size_t);
+    ggc_size_t estimate = (ggc_size_t)
+        (bytes / (1 - expNeg((double) bytes / ggggc_profileRate)));
+
+    ggggc_profileLeft = nextSample();
+
+#ifdef GGGGC_PROFILE_BACKTRACE
+    /* leaving out this frame */
+    depth = backtrace(pcs, GGGGC_PROFILE_DEPTH + 1) - 1;
+    if (depth < 0) depth = 0;
+#endif
+
+    stack = stackFor(ggggc_descriptorName(descriptor), depth, pcs + 1);
+    stack->allocs++;
+    stack->allocBytes += bytes;
+    stack->allocEstimate += estimate;
+    stack->live++;
+    stack->liveBytes += bytes;
+    stack->liveEstimate += estimate;
+
+    if (samplesUsed == samplesSize) {
+        samplesSize = samplesSize ? samplesSize * 2 : 1024;
+        samples = (struct GGGGC_ProfileSample *)
+            realloc(samples, samplesSize * sizeof(struct GGGGC_ProfileSample));
+        if (!samples) {
+            perror("realloc");
+            abort();
+        }
+    }
+    sample = &samples[samplesUsed++];
+    sample->obj = obj;
+    sample->stack = stack;
+    sample->bytes = bytes;
+    sample->estimate = estimate;
+    sample->born = allocatedNow();
+}
+
+/* the mark is done, so anything sampled that it didn't reach is dead */
+void ggggc_profileMarked()
+{
+    ggc_size_t i = 0, now = allocatedNow();
+
+    while (i < samplesUsed) {
+        struct GGGGC_ProfileSample *sample = &samples[i];
+        if (ggggc_isMarked(sample->obj)) {
+            i++;
+            continue;
+        }
+        sample->stack->lifetimes->
+            died[GGGGC_MSB(now - sample->born + 1)]++;
+        sample->stack->live--;
+        sample->stack->liveBytes -= sample->bytes;
+        sample->stack->liveEstimate -= sample->estimate;
+        *sample = samples[--samplesUsed];
+    }
+}
+
+/* start (or with a rate of 0, stop) sampling, about once per rate bytes */
+void ggggc_profileStart(ggc_size_t rate)
+{
+    ggggc_profileRate = rate;
+    if (!rate) {
+        ggggc_profileLeft = (ggc_size_t) -1;
+        return;
+    }
+    if (!profileStartTime) {
+        profileStartTime = ggggc_now();
+        profileStartBytes = allocatedNow();
+    }
+    ggggc_profileLeft = nextSample();
+}
+
+/* write the profile in pprof's legacy heap format */
+int ggggc_profileWrite(const char *path)
+{
+    FILE *out, *maps;
+    ggc_size_t i, live = 0, liveBytes = 0, allocs = 0, allocBytes = 0;
+    int j;
+
+    out = fopen(path, "w");
+    if (!out) {
+        perror(path);
+        return 0;
+    }
+
+    for (i = 0; i < stacksSize; i++) {
+        struct GGGGC_ProfileStack *stack = stacks[i];
+        if (!stack) continue;
+        live += stack->live;
+        liveBytes += stack->liveBytes;
+        allocs += stack->allocs;
+        allocBytes += stack->allocBytes;
+    }
+
+    fprintf(out, "heap profile: %lu: %lu [%lu: %lu] @ heap_v2/%lu\n",
+        (unsigned long) live, (unsigned long) liveBytes,
+        (unsigned long) allocs, (unsigned long) allocBytes,
+        (unsigned long) ggggc_profileRate);
+    for (i = 0; i < stacksSize; i++) {
+        struct GGGGC_ProfileStack *stack = stacks[i];
+        if (!stack) continue;
+        fprintf(out, "%lu: %lu [%lu: %lu] @",
+            (unsigned long) stack->live, (unsigned long) stack->liveBytes,
+            (unsigned long) stack->allocs, (unsigned long) stack->allocBytes);
+        for (j = 0; j < stack->depth; j++)
+            fprintf(out, " %p", stack->pcs[j]);
+        fprintf(out, "\n");
+    }
+
+    /* pprof needs the mappings to symbolize */
+    maps = fopen("/proc/self/maps", "r");
+    if (maps) {
+        char buf[4096];
+        size_t rd;
+        fprintf(out, "\nMAPPED_LIBRARIES:\n");
+        while ((rd = fread(buf, 1, sizeof(buf), maps)) > 0)
+            fwrite(buf, 1, rd, out);
+        fclose(maps);
+    }
+
+    fclose(out);
+    return 1;
+}
+
+static int compareStacks(const void *l, const void *r)
+{
+    const struct GGGGC_ProfileStack *ls = *(struct GGGGC_ProfileStack **) l;
+    const struct GGGGC_ProfileStack *rs = *(struct GGGGC_ProfileStack **) r;
+    if (ls->liveEstimate != rs->liveEstimate)
+        return (ls->liveEstimate < rs->liveEstimate) ? 1 : -1;
+    if (ls->allocEstimate != rs->allocEstimate)
+        return (ls->allocEstimate < rs->allocEstimate) ? 1 : -1;
+    return 0;
+}
+
+/* write the profile at exit */
+static char *exitPath;
+static void writeAtExit(void)
+{
+    ggggc_profileWrite(exitPath);
+}
+
+void ggggc_profileOnExit(const char *path)
+{
+    int registered = !!exitPath;
+    free(exitPath);
+    exitPath = (char *) malloc(strlen(path) + 1);
+    if (!exitPath) {
+        perror("malloc");
+        abort();
+    }
+    strcpy(exitPath, path);
+    if (!registered) atexit(writeAtExit);
+}
+
+/* the fraction of sampled objects of the given type (or all types, if NULL)
+ * which lived past the given age in bytes allocated, rounded down to a power
+ * of two. Samples still alive count only once they've reached that age, and
+ * if the profile isn't that old yet, it's not known (-1). */
+double ggggc_survival(const char *type, ggc_size_t age)
+{
+    struct GGGGC_ProfileLifetimes *lt;
+    ggc_size_t died = 0, survived = 0, i, now = allocatedNow();
+    int bucket = GGGGC_MSB(age ? age : 1);
+
+    if (now - profileStartBytes < ((ggc_size_t) 1 << bucket)) return -1;
+
+    for (lt = lifetimes; lt; lt = lt->next) {
+        if (type && strcmp(lt->type, type)) continue;
+        for (i = 0; i < GGGGC_BITS_PER_WORD; i++) {
+            if ((int) i < bucket) died += lt->died[i];
+            else survived += lt->died[i];
+        }
+    }
+
+    for (i = 0; i < samplesUsed; i++) {
+        if (type && strcmp(samples[i].stack->type, type)) continue;
+        if (GGGGC_MSB(now - samples[i].born + 1) >= bucket) survived++;
+    }
+
+    if (!died && !survived) return 0;
+    return (double) survived / (died + survived);
+}
+
+/* print each type's survival curve to stderr */
+void ggggc_reportLifetimes()
+{
+    static const ggc_size_t ages[] = {
+        1 << 10, 1 << 14, 1 << 18, 1 << 22, 1 << 26, (ggc_size_t) 1 << 30
+    };
+    static const char *ageNames[] = {"1K", "16K", "256K", "4M", "64M", "1G"};
+    struct GGGGC_ProfileLifetimes *lt;
+    ggc_size_t i;
+
+    if (!lifetimes) return;
+
+    fprintf(stderr, "GGGGC: sampled objects surviving past bytes allocated:\n"
+                    "GGGGC: ");
+    for (i = 0; i < sizeof(ages) / sizeof(ages[0]); i++)
+        fprintf(stderr, "%7s", ageNames[i]);
+    fprintf(stderr, "  type\n");
+
+    for (lt = lifetimes; lt; lt = lt->next) {
+        fprintf(stderr, "GGGGC: ");
+        for (i = 0; i < sizeof(ages) / sizeof(ages[0]); i++) {
+            double survival = ggggc_survival(lt->type, ages[i]);
+            if (survival < 0) fprintf(stderr, "%7s", "-");
+            else fprintf(stderr, "%6.1f%%", survival * 100);
+        }
+        fprintf(stderr, "  %s\n", lt->type);
+    }
+}
+
+/* print the call stacks retaining (and allocating) the most to stderr */
+void ggggc_reportProfile()
+{
+    struct GGGGC_ProfileStack **sorted;
+    ggc_size_t i, j, elapsed;
+    double seconds;
+
+    if (!stacksUsed) return;
+
+    sorted = (struct GGGGC_ProfileStack **)
+        malloc(stacksUsed * sizeof(struct GGGGC_ProfileStack *));
+    if (!sorted) {
+        perror("malloc");
+        abort();
+    }
+    for (i = j = 0; i < stacksSize; i++)
+        if (stacks[i]) sorted[j++] = stacks[i];
+    qsort(sorted, stacksUsed, sizeof(struct GGGGC_ProfileStack *),
+        compareStacks);
+
+    elapsed = ggggc_now() - profileStartTime;
+    seconds = elapsed ? elapsed / 1e9 : 1;
+
+    fprintf(stderr, "GGGGC: allocation profile, sampled every %lu bytes:\n"
+                    "GGGGC: %14s %14s %12s  %s\n",
+        (unsigned long) ggggc_profileRate,
+        "retained", "allocated", "bytes/sec", "type");
+    for (i = 0; i < stacksUsed && i < 10; i++) {
+        struct GGGGC_ProfileStack *stack = sorted[i];
+        fprintf(stderr, "GGGGC: %14lu %14lu %12.0f  %s\n",
+            (unsigned long) stack->liveEstimate,
+            (unsigned long) stack->allocEstimate,
+            stack->allocEstimate / seconds, stack->type);
+#ifdef GGGGC_PROFILE_BACKTRACE
+        {
+            char **syms = backtrace_symbols(stack->pcs, stack->depth);
+            int k;
+            if (syms) {
+                for (k = 0; k < stack->depth && k < 6; k++)
+                    fprintf(stderr, "GGGGC: %44s  %s\n", "", syms[k]);
+                free(syms);
+            }
+        }
+#endif
+    }
+
+    free(sorted);
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -22,6 +22,7 @@
 #include <sys/types.h>
 
 #include "ggggc/gc.h"
+#include "ggggc-internals.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -45,6 +46,7 @@ void ggggc_globalize()
         struct GGGGC_PointerStack *cur = ggggc_pointerStack;
         while (cur->next) cur = cur->next;
         ggggc_pointerStackGlobals = cur;
+        ggggc_pointerStackGlobalsStart = gPointerStack;
     }
     ggggc_pointerStackGlobals->next = gPointerStack;
     ggggc_pointerStackGlobals = gPointerStack;
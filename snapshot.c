@@ -0,0 +1,516 @@
+/*
+ * In-process heap snapshots and diffs
+ *
+ * Copyright (c) 2014, 2015 Gregor Richards
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION
+ * OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+
+#include "ggggc/gc.h"
+#include "ggggc-internals.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* A snapshot counts the live objects and bytes on each retention path: the
+ * types of the objects through which the mark first reached an object, back
+ * to the root it came from. Runs of the same type (e.g. a list) are collapsed
+ * into one step, and paths are cut off at GGGGC_SNAPSHOT_PATH_DEPTH steps.
+ * Paths are interned for the life of the process, so two snapshots can be
+ * compared path by path without keeping either heap. */
+#ifndef GGGGC_SNAPSHOT_PATH_DEPTH
+#define GGGGC_SNAPSHOT_PATH_DEPTH 16
+#endif
+
+#define GGGGC_SNAPSHOT_NONE ((ggc_size_t) -1)
+
+/* a path: a type, then the path of what reached it. Roots are paths with no
+ * type, named by where they are, counted from the bottom of the stack or the
+ * first global, which stays the same from snapshot to snapshot. */
+struct GGGGC_SnapshotPath {
+    const char *type;
+    ggc_size_t parent; /* or GGGGC_SNAPSHOT_NONE for a root */
+    int global;
+    ggc_size_t frame;
+    int depth;
+    char *description;
+};
+
+struct GGGGC_SnapshotCount {
+    ggc_size_t objects, bytes;
+};
+
+int ggggc_markParents;
+
+/* what first reached each object in this snapshot's mark, open-addressed */
+struct GGGGC_SnapshotParent {
+    void *obj, *parent;
+    ggc_size_t path;
+};
+static struct GGGGC_SnapshotParent *parents;
+static ggc_size_t parentsSize, parentsUsed;
+
+/* every path ever seen, and an open-addressed index of them */
+static struct GGGGC_SnapshotPath *paths;
+static ggc_size_t pathsSize, pathsUsed;
+static ggc_size_t *pathIndex, pathIndexSize;
+
+/* and the counts of the last two snapshots, by path */
+static struct GGGGC_SnapshotCount *previous, *current;
+static ggc_size_t previousSize, currentSize;
+
+/* and by each object's own type, open-addressed, since a path cut off at
+ * GGGGC_SNAPSHOT_PATH_DEPTH ends in some other type */
+struct GGGGC_SnapshotType {
+    const char *type;
+    struct GGGGC_SnapshotCount previous, current;
+};
+static struct GGGGC_SnapshotType *types;
+static ggc_size_t typesSize, typesUsed;
+
+static ggc_size_t hashOf(ggc_size_t v)
+{
+    v ^= v >> 17;
+    v *= (ggc_size_t) 0x9E3779B97F4A7C15ULL;
+    return v ^ (v >> 29);
+}
+
+static struct GGGGC_SnapshotParent *parentSlot(void *obj)
+{
+    ggc_size_t i = hashOf((ggc_size_t) obj) & (parentsSize - 1);
+    while (parents[i].obj && parents[i].obj != obj)
+        i = (i + 1) & (parentsSize - 1);
+    return &parents[i];
+}
+
+static void growParents(ggc_size_t size)
+{
+    struct GGGGC_SnapshotParent *old = parents;
+    ggc_size_t oldSize = parentsSize, i;
+
+    parents = (struct GGGGC_SnapshotParent *)
+        calloc(size, sizeof(struct GGGGC_SnapshotParent));
+    if (!parents) {
+        perror("calloc");
+        abort();
+    }
+    parentsSize = size;
+
+    for (i = 0; i < oldSize; i++)
+        if (old[i].obj) *parentSlot(old[i].obj) = old[i];
+    free(old);
+}
+
+static struct GGGGC_SnapshotType *typeSlot(const char *type)
+{
+    ggc_size_t i = hashOf((ggc_size_t) type) & (typesSize - 1);
+    while (types[i].type && types[i].type != type)
+        i = (i + 1) & (typesSize - 1);
+    return &types[i];
+}
+
+/* the counts for a type, added if it's new */
+static struct GGGGC_SnapshotType *countsOf(const char *type)
+{
+    struct GGGGC_SnapshotType *slot;
+
+    if ((typesUsed + 1) * 2 > typesSize) {
+        struct GGGGC_SnapshotType *old = types;
+        ggc_size_t oldSize = typesSize, i;
+
+        typesSize = typesSize ? typesSize * 2 : 64;
+        types = (struct GGGGC_SnapshotType *)
+            calloc(typesSize, sizeof(struct GGGGC_SnapshotType));
+        if (!types) {
+            perror("calloc");
+            abort();
+        }
+        for (i = 0; i < oldSize; i++)
+            if (old[i].type) *typeSlot(old[i].type) = old[i];
+        free(old);
+    }
+
+    slot = typeSlot(type);
+    if (!slot->type) {
+        slot->type = type;
+        typesUsed++;
+    }
+    return slot;
+}
+
+/* the mark reached obj from parent; only the first is remembered */
+void ggggc_recordParent(void *obj, void *parent)
+{
+    struct GGGGC_SnapshotParent *slot;
+
+    if ((parentsUsed + 1) * 2 > parentsSize)
+        growParents(parentsSize ? parentsSize * 2 : 4096);
+
+    slot = parentSlot(obj);
+    if (slot->obj) return;
+    slot->obj = obj;
+    slot->parent = parent;
+    slot->path = GGGGC_SNAPSHOT_NONE;
+    parentsUsed++;
+}
+
+static ggc_size_t pathHash(const char *type, ggc_size_t parent, int global,
+    ggc_size_t frame)
+{
+    return hashOf((ggc_size_t) type ^ hashOf(parent ^ hashOf(frame + global)));
+}
+
+/* the index slot for a path, holding its number + 1, or 0 if it's new */
+static ggc_size_t *pathSlot(const char *type, ggc_size_t parent, int global,
+    ggc_size_t frame)
+{
+    ggc_size_t i = pathHash(type, parent, global, frame) & (pathIndexSize - 1);
+    while (pathIndex[i]) {
+        struct GGGGC_SnapshotPath *path = &paths[pathIndex[i] - 1];
+        if (path->type == type && path->parent == parent &&
+            path->global == global && path->frame == frame)
+            break;
+        i = (i + 1) & (pathIndexSize - 1);
+    }
+    return &pathIndex[i];
+}
+
+/* find or add a path */
+static ggc_size_t intern(const char *type, ggc_size_t parent, int global,
+    ggc_size_t frame)
+{
+    struct GGGGC_SnapshotPath *path;
+    ggc_size_t *slot;
+
+    if ((pathsUsed + 1) * 2 > pathIndexSize) {
+        ggc_size_t i;
+        free(pathIndex);
+        pathIndexSize = pathIndexSize ? pathIndexSize * 2 : 256;
+        pathIndex = (ggc_size_t *) calloc(pathIndexSize, sizeof(ggc_size_t));
+        if (!pathIndex) {
+            perror("calloc");
+            abort();
+        }
+        for (i = 0; i < pathsUsed; i++) {
+            path = &paths[i];
+            *pathSlot(path->type, path->parent, path->global, path->frame) =
+                i + 1;
+        }
+    }
+
+    slot = pathSlot(type, parent, global, frame);
+    if (*slot) return *slot - 1;
+
+    if (pathsUsed == pathsSize) {
+        pathsSize = pathsSize ? pathsSize * 2 : 64;
+        paths = (struct GGGGC_SnapshotPath *)
+            realloc(paths, pathsSize * sizeof(struct GGGGC_SnapshotPath));
+        if (!paths) {
+            perror("realloc");
+            abort();
+        }
+    }
+    path = &paths[pathsUsed];
+    path->type = type;
+    path->parent = parent;
+    path->global = global;
+    path->frame = frame;
+    path->depth = (parent == GGGGC_SNAPSHOT_NONE) ? 0 :
+        paths[parent].depth + 1;
+    path->description = NULL;
+    *slot = pathsUsed + 1;
+    return pathsUsed++;
+}
+
+/* the path of a root in the given frame */
+static ggc_size_t rootPath(struct GGGGC_PointerStack *frame)
+{
+    struct GGGGC_PointerStack *iter;
+    ggc_size_t index = 0, stackFrames = 0;
+    int global = 0;
+
+    for (iter = ggggc_pointerStack; iter; iter = iter->next) {
+        if (iter == ggggc_pointerStackGlobalsStart) break;
+        stackFrames++;
+    }
+    for (iter = ggggc_pointerStack; iter && iter != frame; iter = iter->next) {
+        if (iter == ggggc_pointerStackGlobalsStart) global = 1;
+        index++;
+    }
+    if (iter == ggggc_pointerStackGlobalsStart) global = 1;
+
+    /* count from the bottom of the stack, or the first global */
+    if (global) index -= stackFrames;
+    else index = stackFrames - 1 - index;
+
+    return intern(NULL, GGGGC_SNAPSHOT_NONE, global, index);
+}
+
+/* the path of an object, found by walking back through what reached it */
+static ggc_size_t pathOf(struct GGGGC_SnapshotParent *slot)
+{
+    static struct GGGGC_SnapshotParent **chain;
+    static ggc_size_t chainSize;
+    ggc_size_t chainUsed = 0, path;
+
+    /* walk back to a root or an object whose path we already know */
+    while (1) {
+        if (slot->path != GGGGC_SNAPSHOT_NONE) {
+            path = slot->path;
+            break;
+        }
+
+        if (chainUsed == chainSize) {
+            chainSize = chainSize ? chainSize * 2 : 1024;
+            chain = (struct GGGGC_SnapshotParent **)
+                realloc(chain, chainSize * sizeof(*chain));
+            if (!chain) {
+                perror("realloc");
+                abort();
+            }
+        }
+        chain[chainUsed++] = slot;
+
+        if ((ggc_size_t) slot->parent & 1) {
+            path = rootPath((struct GGGGC_PointerStack *)
+                ((ggc_size_t) slot->parent & ~(ggc_size_t) 1));
+            break;
+        }
+        slot = parentSlot(slot->parent);
+        if (!slot->obj) {
+            /* can't happen: whatever reached an object was itself reached */
+            path = intern(NULL, GGGGC_SNAPSHOT_NONE, 0, GGGGC_SNAPSHOT_NONE);
+            break;
+        }
+    }
+
+    /* then extend that path forward to each object on the way */
+    while (chainUsed) {
+        const char *type;
+        slot = chain[--chainUsed];
+        type = ggggc_descriptorName(GGGGC_DESCRIPTOR_OF(slot->obj));
+        if (paths[path].type != type &&
+            paths[path].depth < GGGGC_SNAPSHOT_PATH_DEPTH)
+            path = intern(type, path, 0, GGGGC_SNAPSHOT_NONE);
+        slot->path = path;
+    }
+
+    return path;
+}
+
+/* take a snapshot, keeping the last one to compare it to */
+void ggggc_snapshot()
+{
+    struct GGGGC_SnapshotCount *swap;
+    ggc_size_t i, start;
+
+    /* collect, remembering what reached each object */
+    ggggc_sweep();
+    ggggc_markParents = 1;
+    ggggc_collect();
+    ggggc_markParents = 0;
+    start = ggggc_now();
+
+    swap = previous;
+    previous = current;
+    current = swap;
+    i = previousSize;
+    previousSize = currentSize;
+    currentSize = i;
+    if (current) memset(current, 0, currentSize * sizeof(*current));
+    for (i = 0; i < typesSize; i++) {
+        types[i].previous = types[i].current;
+        types[i].current.objects = types[i].current.bytes = 0;
+    }
+
+    /* count each live object on its path, and as its type */
+    for (i = 0; i < parentsSize; i++) {
+        struct GGGGC_SnapshotParent *slot = &parents[i];
+        struct GGGGC_SnapshotType *type;
+        ggc_size_t path, bytes;
+        if (!slot->obj) continue;
+        path = pathOf(slot);
+        bytes = GGGGC_DESCRIPTOR_OF(slot->obj)->size * sizeof(ggc_size_t);
+
+        if (pathsUsed > currentSize) {
+            ggc_size_t old = currentSize;
+            currentSize = pathsSize;
+            current = (struct GGGGC_SnapshotCount *)
+                realloc(current, currentSize * sizeof(*current));
+            if (!current) {
+                perror("realloc");
+                abort();
+            }
+            memset(current + old, 0, (currentSize - old) * sizeof(*current));
+        }
+        current[path].objects++;
+        current[path].bytes += bytes;
+
+        type = countsOf(ggggc_descriptorName(GGGGC_DESCRIPTOR_OF(slot->obj)));
+        type->current.objects++;
+        type->current.bytes += bytes;
+    }
+
+    /* the parents can be large, and aren't needed until the next snapshot */
+    free(parents);
+    parents = NULL;
+    parentsSize = parentsUsed = 0;
+
+    GGGGC_TRACE_SPAN("snapshot", start, ggggc_now(), "paths", pathsUsed);
+}
+
+/* describe a path, from the object back to its root */
+static const char *describe(ggc_size_t path)
+{
+    struct GGGGC_SnapshotPath *p = &paths[path];
+    char root[64];
+    const char *rest;
+    size_t length;
+
+    if (p->description) return p->description;
+
+    if (p->type) {
+        rest = describe(p->parent);
+        length = strlen(p->type) + strlen(rest) + 5;
+        p->description = (char *) malloc(length);
+        if (!p->description) {
+            perror("malloc");
+            abort();
+        }
+        sprintf(p->description, "%s <- %s", p->type, rest);
+
+    } else {
+        if (p->frame == GGGGC_SNAPSHOT_NONE)
+            strcpy(root, "(unknown root)");
+        else
+            sprintf(root, "%s %lu", p->global ? "global" : "stack frame",
+                (unsigned long) p->frame);
+        p->description = (char *) malloc(strlen(root) + 1);
+        if (!p->description) {
+            perror("malloc");
+            abort();
+        }
+        strcpy(p->description, root);
+
+    }
+
+    return p->description;
+}
+
+static int compareDeltas(const void *l, const void *r)
+{
+    const struct GGGGC_SnapshotDelta *ld =
+        (const struct GGGGC_SnapshotDelta *) l;
+    const struct GGGGC_SnapshotDelta *rd =
+        (const struct GGGGC_SnapshotDelta *) r;
+    if (ld->bytes != rd->bytes) return (ld->bytes < rd->bytes) ? 1 : -1;
+    if (ld->objects != rd->objects) return (ld->objects < rd->objects) ? 1 : -1;
+    return strcmp(ld->path, rd->path);
+}
+
+/* what grew on each path since the last snapshot, largest first */
+static struct GGGGC_SnapshotDelta *grown(ggc_size_t *count)
+{
+    struct GGGGC_SnapshotDelta *ret;
+    ggc_size_t i, used = 0;
+
+    ret = (struct GGGGC_SnapshotDelta *)
+        malloc((pathsUsed + 1) * sizeof(struct GGGGC_SnapshotDelta));
+    if (!ret) {
+        perror("malloc");
+        abort();
+    }
+
+    for (i = 0; i < pathsUsed; i++) {
+        struct GGGGC_SnapshotCount was = {0, 0}, is = {0, 0};
+        if (i < previousSize) was = previous[i];
+        if (i < currentSize) is = current[i];
+        if (is.objects <= was.objects && is.bytes <= was.bytes) continue;
+        ret[used].type = paths[i].type;
+        ret[used].path = describe(i);
+        ret[used].objects = (long) is.objects - (long) was.objects;
+        ret[used].bytes = (long) is.bytes - (long) was.bytes;
+        used++;
+    }
+    qsort(ret, used, sizeof(struct GGGGC_SnapshotDelta), compareDeltas);
+
+    *count = used;
+    return ret;
+}
+
+ggc_size_t ggggc_snapshotDiff(struct GGGGC_SnapshotDelta *deltas,
+    ggc_size_t max)
+{
+    ggc_size_t count;
+    struct GGGGC_SnapshotDelta *all = grown(&count);
+    memcpy(deltas, all,
+        ((max < count) ? max : count) * sizeof(struct GGGGC_SnapshotDelta));
+    free(all);
+    return count;
+}
+
+/* print how each type changed, and the paths which grew, to stderr */
+void ggggc_reportSnapshotDiff()
+{
+    struct GGGGC_SnapshotDelta *all, *byType;
+    ggc_size_t count, used = 0, i;
+
+    all = grown(&count);
+
+    /* every type, counted by itself rather than by path, so objects which
+     * merely moved from one path to another cancel out */
+    byType = (struct GGGGC_SnapshotDelta *)
+        malloc((typesUsed + 1) * sizeof(struct GGGGC_SnapshotDelta));
+    if (!byType) {
+        perror("malloc");
+        abort();
+    }
+    for (i = 0; i < typesSize; i++) {
+        struct GGGGC_SnapshotType *type = &types[i];
+        if (!type->type) continue;
+        if (type->current.objects == type->previous.objects &&
+            type->current.bytes == type->previous.bytes) continue;
+        byType[used].type = byType[used].path = type->type;
+        byType[used].objects =
+            (long) type->current.objects - (long) type->previous.objects;
+        byType[used].bytes =
+            (long) type->current.bytes - (long) type->previous.bytes;
+        used++;
+    }
+    qsort(byType, used, sizeof(struct GGGGC_SnapshotDelta), compareDeltas);
+
+    fprintf(stderr, "GGGGC: change since the last snapshot:\n"
+                    "GGGGC: %12s %14s  %s\n", "objects", "bytes", "type");
+    for (i = 0; i < used; i++)
+        fprintf(stderr, "GGGGC: %+12ld %+14ld  %s\n", byType[i].objects,
+            byType[i].bytes, byType[i].type);
+
+    fprintf(stderr, "GGGGC: %12s %14s  %s\n", "objects", "bytes",
+        "retention path");
+    for (i = 0; i < count && i < 10; i++)
+        fprintf(stderr, "GGGGC: %+12ld %+14ld  %s\n", all[i].objects,
+            all[i].bytes, all[i].path);
+
+    free(byType);
+    free(all);
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,92 @@
+/*
+ * Profiles a program which keeps one long list and churns through short ones:
+ * the profile's estimate of what's retained should match the long list, and
+ * only the long list should survive long.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "ggggc/gc.h"
+
+GGC_TYPE(Cell)
+    GGC_MPTR(Cell, next);
+    GGC_MDATA(long, val);
+GGC_END_TYPE(Cell,
+    GGC_PTR(Cell, next)
+    )
+
+/* build a list of the given length */
+static Cell build(long length)
+{
+    Cell list = NULL, cell = NULL;
+    long i;
+
+    GGC_PUSH_2(list, cell);
+
+    for (i = 0; i < length; i++) {
+        cell = GGC_NEW(Cell);
+        GGC_WD(cell, val, i);
+        GGC_WP(cell, next, list);
+        list = cell;
+    }
+
+    return list;
+}
+
+int main(int argc, char **argv)
+{
+    Cell longLived = NULL, temp = NULL;
+    const char *path;
+    FILE *in;
+    unsigned long live, liveBytes, allocs, allocBytes, rate;
+    double retained, expected, survival;
+    long i;
+
+    GGC_PUSH_2(longLived, temp);
+
+    path = (argc > 1) ? argv[1] : "allocprof.heap";
+
+    GGC_PROFILE_START(4096);
+    longLived = build(100000);
+    for (i = 0; i < 100; i++) {
+        temp = build(10000);
+        /* lifetimes are only as precise as collections are frequent */
+        GGC_COLLECT();
+    }
+    temp = NULL;
+    GGC_COLLECT();
+
+    if (!GGC_PROFILE_WRITE(path)) return 1;
+    in = fopen(path, "r");
+    if (!in ||
+        fscanf(in, "heap profile: %lu: %lu [%lu: %lu] @ heap_v2/%lu",
+            &live, &liveBytes, &allocs, &allocBytes, &rate) != 5) {
+        fprintf(stderr, "ERROR! Couldn't read the profile back!\n");
+        return 1;
+    }
+    fclose(in);
+
+    /* each sample of a small object stands for rate bytes */
+    retained = (double) live * rate;
+    expected = 100000.0 * Cell__descriptorSlot.size * sizeof(ggc_size_t);
+    if (retained < expected * 0.75 || retained > expected * 1.25) {
+        fprintf(stderr, "ERROR! Estimated %.0f bytes retained, expected %.0f!\n",
+            retained, expected);
+        return 1;
+    }
+
+    /* the short lists are each dead by the time the next is collected */
+    survival = GGC_SURVIVAL("Cell", 1 << 20);
+    if (survival < (double) live / allocs * 0.9 ||
+        survival > (double) live / allocs * 1.1) {
+        fprintf(stderr, "ERROR! %.1f%% of Cells survived 1M, expected %.1f%%!\n",
+            survival * 100, (double) live / allocs * 100);
+        return 1;
+    }
+
+    printf("Estimated %.0f bytes retained of %.0f, from %lu of %lu samples\n",
+        retained, expected, live, allocs);
+
+    return 0;
+}
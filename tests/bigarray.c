@@ -0,0 +1,66 @@
+/*
+ * A benchmark of huge pointer arrays. A million-element array of small
+ * objects is kept live while garbage is churned through the heap.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+#include "ggggc/gc.h"
+
+GGC_TYPE(Box)
+    GGC_MPTR(Box, next);
+    GGC_MDATA(long, val);
+GGC_END_TYPE(Box,
+    GGC_PTR(Box, next)
+    )
+
+static long now(void)
+{
+    struct timeval t;
+    gettimeofday(&t, NULL);
+    return t.tv_sec * 1000 + t.tv_usec / 1000;
+}
+
+int main(int argc, char **argv)
+{
+    GGC_voidpArray array = NULL;
+    Box box = NULL, junk = NULL;
+    long i, len, iters, tStart;
+
+    GGC_PUSH_3(array, box, junk);
+
+    len = (argc > 1) ? atol(argv[1]) : 1024 * 1024;
+    iters = (argc > 2) ? atol(argv[2]) : 8;
+
+    tStart = now();
+    array = GGC_NEW_PA(GGC_voidp, len);
+
+    /* leave every other slot NULL */
+    for (i = 0; i < len; i += 2) {
+        box = GGC_NEW(Box);
+        GGC_WD(box, val, i);
+        GGC_WAP(array, i, box);
+    }
+    box = NULL;
+
+    /* churn enough garbage to force several collections */
+    for (i = 0; i < len * iters; i++) {
+        junk = GGC_NEW(Box);
+        GGC_WD(junk, val, i);
+    }
+    junk = NULL;
+
+    for (i = 0; i < len; i++) {
+        box = (Box) GGC_RAP(array, i);
+        if ((i % 2) ? (box != NULL) : (box == NULL || GGC_RD(box, val) != i)) {
+            fprintf(stderr, "ERROR! Slot %ld is corrupt!\n", i);
+            return 1;
+        }
+    }
+
+    printf("Completed in %d msec\n", (int) (now() - tStart));
+
+    return 0;
+}
@@ -0,0 +1,81 @@
+/*
+ * A benchmark of full collections over a large live heap, to compare pool
+ * backings. Usage: bigheap [tree depth [collections]], with the backing chosen
+ * by GGGGC_HUGE_PAGES, which is read before the first pool is allocated: 0
+ * (normal pages), 1 (transparent huge pages) or 2 (explicit huge pages). Run
+ * it under `perf stat -e dTLB-load-misses` to see the TLB side of the story.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "ggggc/gc.h"
+
+GGC_TYPE(Node)
+    GGC_MPTR(Node, left);
+    GGC_MPTR(Node, right);
+    GGC_MDATA(long, val);
+GGC_END_TYPE(Node,
+    GGC_PTR(Node, left)
+    GGC_PTR(Node, right)
+    )
+
+static double now(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec * 1000.0 + t.tv_nsec / 1000000.0;
+}
+
+/* build a tree top-down, so neighbours in the tree are scattered in memory */
+static Node makeTree(int depth)
+{
+    Node ret = NULL, l = NULL, r = NULL;
+
+    GGC_PUSH_3(ret, l, r);
+
+    ret = GGC_NEW(Node);
+    if (depth > 0) {
+        l = makeTree(depth - 1);
+        r = makeTree(depth - 1);
+        GGC_WP(ret, left, l);
+        GGC_WP(ret, right, r);
+    }
+
+    return ret;
+}
+
+int main(int argc, char **argv)
+{
+    Node tree = NULL;
+    struct GGGGC_Config config;
+    struct GGGGC_Stats stats;
+    int depth, collections, i;
+    double tStart, total = 0, best = 0;
+
+    GGC_PUSH_1(tree);
+
+    depth = (argc > 1) ? atoi(argv[1]) : 22;
+    collections = (argc > 2) ? atoi(argv[2]) : 10;
+
+    tree = makeTree(depth);
+    GGC_GET_CONFIG(&config);
+    GGC_GET_STATS(&stats);
+    printf("Live heap of %lu pools, huge page mode %d\n",
+        (unsigned long) stats.poolCount, config.hugePages);
+
+    for (i = 0; i < collections; i++) {
+        double t;
+        tStart = now();
+        GGC_COLLECT();
+        t = now() - tStart;
+        total += t;
+        if (!i || t < best) best = t;
+    }
+
+    printf("%d collections, average %.2f msec, best %.2f msec\n",
+        collections, total / collections, best);
+
+    return 0;
+}
@@ -0,0 +1,116 @@
+/*
+ * A benchmark of types too large to be described by a single descriptor word.
+ * Each Big object has 200 fields, with pointers spread across every word of
+ * its pointer bitmap.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+#include "ggggc/gc.h"
+
+#define D10(n) \
+    GGC_MDATA(long, n ## 0); GGC_MDATA(long, n ## 1); \
+    GGC_MDATA(long, n ## 2); GGC_MDATA(long, n ## 3); \
+    GGC_MDATA(long, n ## 4); GGC_MDATA(long, n ## 5); \
+    GGC_MDATA(long, n ## 6); GGC_MDATA(long, n ## 7); \
+    GGC_MDATA(long, n ## 8); GGC_MDATA(long, n ## 9);
+#define D50(n) D10(n ## a) D10(n ## b) D10(n ## c) D10(n ## d) D10(n ## e)
+
+/* 4 pointers and 196 data fields */
+GGC_TYPE(Big)
+    GGC_MPTR(Big, first);
+    D50(w)
+    GGC_MPTR(Big, left);
+    D50(x)
+    GGC_MPTR(Big, right);
+    D50(y)
+    D10(za) D10(zb) D10(zc) D10(zd)
+    GGC_MDATA(long, z0); GGC_MDATA(long, z1);
+    GGC_MDATA(long, z2); GGC_MDATA(long, z3);
+    GGC_MDATA(long, z4);
+    GGC_MPTR(Big, last);
+    GGC_MDATA(long, item);
+GGC_END_TYPE(Big,
+    GGC_PTR(Big, first)
+    GGC_PTR(Big, left)
+    GGC_PTR(Big, right)
+    GGC_PTR(Big, last)
+    )
+
+static long now(void)
+{
+    struct timeval t;
+    gettimeofday(&t, NULL);
+    return t.tv_sec * 1000 + t.tv_usec / 1000;
+}
+
+/* build a tree linked only through the high fields */
+static Big makeTree(long item, int depth)
+{
+    Big ret = NULL, l = NULL, r = NULL;
+
+    GGC_PUSH_3(ret, l, r);
+
+    ret = GGC_NEW(Big);
+    GGC_WD(ret, item, item);
+    if (depth > 0) {
+        l = makeTree(2 * item, depth - 1);
+        r = makeTree(2 * item + 1, depth - 1);
+        GGC_WP(ret, right, l);
+        GGC_WP(ret, last, r);
+    }
+
+    return ret;
+}
+
+static long checkTree(Big tree)
+{
+    long ret;
+
+    GGC_PUSH_1(tree);
+
+    ret = GGC_RD(tree, item);
+    if (GGC_RP(tree, right))
+        ret += checkTree(GGC_RP(tree, right)) + checkTree(GGC_RP(tree, last));
+
+    return ret;
+}
+
+int main(int argc, char **argv)
+{
+    Big longLived = NULL, temp = NULL;
+    int depth, i, iters;
+    long expect, tStart;
+
+    GGC_PUSH_2(longLived, temp);
+
+    depth = (argc > 1) ? atoi(argv[1]) : 12;
+    iters = (argc > 2) ? atoi(argv[2]) : 16;
+
+    printf("Big objects are %d words\n",
+        (int) GGGGC_WORD_SIZEOF(struct Big__ggggc_struct));
+
+    tStart = now();
+    longLived = makeTree(1, depth);
+    expect = checkTree(longLived);
+
+    for (i = 0; i < iters; i++) {
+        temp = makeTree(1, depth);
+        if (checkTree(temp) != expect) {
+            fprintf(stderr, "ERROR! Temporary tree %d is corrupt!\n", i);
+            return 1;
+        }
+        temp = NULL;
+    }
+
+    if (checkTree(longLived) != expect) {
+        fprintf(stderr, "ERROR! Long-lived tree is corrupt!\n");
+        return 1;
+    }
+
+    printf("Completed in %d msec\n", (int) (now() - tStart));
+
+    return 0;
+}
@@ -0,0 +1,130 @@
+/*
+ * Takes a census of a heap with a known shape: the named types should be
+ * counted exactly, and arrays grouped by kind.
+ */
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "ggggc/gc.h"
+
+GGC_TYPE(Cell)
+    GGC_MPTR(Cell, next);
+    GGC_MDATA(long, val);
+GGC_END_TYPE(Cell,
+    GGC_PTR(Cell, next)
+    )
+
+GGC_TYPE(Box)
+    GGC_MPTR(GGC_long_Array, vals);
+GGC_END_TYPE(Box,
+    GGC_PTR(Box, vals)
+    )
+
+/* find a type in the census */
+static struct GGGGC_CensusEntry *find(struct GGGGC_CensusEntry *entries,
+    ggc_size_t count, const char *name)
+{
+    ggc_size_t i;
+    for (i = 0; i < count; i++)
+        if (!strcmp(entries[i].name, name)) return &entries[i];
+    return NULL;
+}
+
+int main(int argc, char **argv)
+{
+    Cell list = NULL, cell = NULL;
+    Box box = NULL;
+    GGC_long_Array vals = NULL;
+    struct GGGGC_CensusEntry entries[16], *entry;
+    struct GGGGC_Stats stats;
+    ggc_size_t count, collections;
+    FILE *report;
+    char line[256], name[64];
+    unsigned long objects, bytes, reported = 0;
+    long cells, i;
+    int savedStderr;
+
+    GGC_PUSH_4(list, cell, box, vals);
+
+    cells = (argc > 1) ? atol(argv[1]) : 100000;
+
+    for (i = 0; i < cells; i++) {
+        cell = GGC_NEW(Cell);
+        GGC_WD(cell, val, i);
+        /* keep every other one */
+        if (i % 2) continue;
+        GGC_WP(cell, next, list);
+        list = cell;
+    }
+    cell = NULL;
+
+    vals = GGC_NEW_DA(long, 1000);
+    box = GGC_NEW(Box);
+    GGC_WP(box, vals, vals);
+    vals = NULL;
+
+    count = GGC_CENSUS(entries, 16);
+    if (count > 16) count = 16;
+
+    entry = find(entries, count, "Cell");
+    if (!entry || entry->objects != (ggc_size_t) (cells + 1) / 2) {
+        fprintf(stderr, "ERROR! Expected %ld Cells, counted %lu!\n",
+            (cells + 1) / 2, entry ? (unsigned long) entry->objects : 0UL);
+        return 1;
+    }
+    entry = find(entries, count, "Box");
+    if (!entry || entry->objects != 1) {
+        fprintf(stderr, "ERROR! Expected one Box!\n");
+        return 1;
+    }
+    entry = find(entries, count, "(data arrays)");
+    if (!entry || entry->bytes < 1000 * sizeof(long)) {
+        fprintf(stderr, "ERROR! The long array wasn't counted!\n");
+        return 1;
+    }
+
+    /* and by signal, at the next allocation, which prints it to stderr */
+    report = tmpfile();
+    if (!report) {
+        perror("tmpfile");
+        return 1;
+    }
+    fflush(stderr);
+    savedStderr = dup(2);
+    dup2(fileno(report), 2);
+
+    GGC_GET_STATS(&stats);
+    collections = stats.collections;
+    GGC_CENSUS_ON_SIGNAL(SIGUSR1);
+    raise(SIGUSR1);
+    cell = GGC_NEW(Cell);
+
+    fflush(stderr);
+    dup2(savedStderr, 2);
+    close(savedStderr);
+
+    GGC_GET_STATS(&stats);
+    rewind(report);
+    while (fgets(line, sizeof(line), report))
+        if (sscanf(line, "GGGGC: %lu %lu %63s", &objects, &bytes, name) == 3 &&
+            !strcmp(name, "Cell"))
+            reported = objects;
+    fclose(report);
+    if (stats.collections != collections + 1 ||
+        reported != (unsigned long) (cells + 1) / 2) {
+        fprintf(stderr, "ERROR! The signal led to %lu collections and a "
+                        "census of %lu Cells, expected 1 and %lu!\n",
+            (unsigned long) (stats.collections - collections), reported,
+            (unsigned long) (cells + 1) / 2);
+        return 1;
+    }
+
+    printf("%lu types, %lu Cells\n", (unsigned long) count,
+        (unsigned long) find(entries, count, "Cell")->objects);
+
+    return 0;
+}
@@ -0,0 +1,60 @@
+/*
+ * Counts hardware events in each phase, if the system allows it, and checks
+ * that the collector carries on either way.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "ggggc/gc.h"
+
+GGC_TYPE(Cell)
+    GGC_MPTR(Cell, next);
+GGC_END_TYPE(Cell,
+    GGC_PTR(Cell, next)
+    )
+
+int main(int argc, char **argv)
+{
+    Cell list = NULL, cell = NULL;
+    struct GGGGC_Counters mark, sweep;
+    long collections, i, j;
+    int counters;
+
+    GGC_PUSH_2(list, cell);
+
+    collections = (argc > 1) ? atol(argv[1]) : 5;
+    counters = GGC_COUNTERS_START();
+
+    for (i = 0; i < collections; i++) {
+        list = NULL;
+        for (j = 0; j < 100000; j++) {
+            cell = GGC_NEW(Cell);
+            GGC_WP(cell, next, list);
+            list = cell;
+        }
+        GGC_COLLECT();
+    }
+
+    if (!counters) {
+        if (GGC_COUNTERS(&mark, &sweep)) {
+            fprintf(stderr, "ERROR! Counting without counters!\n");
+            return 1;
+        }
+        printf("Hardware counters unavailable\n");
+        return 0;
+    }
+
+    if (!GGC_COUNTERS(&mark, &sweep)) {
+        fprintf(stderr, "ERROR! Not counting!\n");
+        return 1;
+    }
+    if ((mark.cycles != GGGGC_COUNTER_UNAVAILABLE && !mark.cycles) ||
+        (sweep.cycles != GGGGC_COUNTER_UNAVAILABLE && !sweep.cycles)) {
+        fprintf(stderr, "ERROR! No cycles counted!\n");
+        return 1;
+    }
+    GGC_REPORT_COUNTERS();
+    printf("Counted %d kinds of hardware event\n", counters);
+    return 0;
+}
@@ -0,0 +1,123 @@
+/*
+ * Leaves holes in the heap, then one large gap, and checks that the free list
+ * metrics see each.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "ggggc/gc.h"
+
+GGC_TYPE(Cell)
+    GGC_MPTR(Cell, next);
+    GGC_MDATA(long, val);
+GGC_END_TYPE(Cell,
+    GGC_PTR(Cell, next)
+    )
+
+#define POOLS 64
+
+/* the total of one size class over every pool */
+static ggc_size_t sizeClass(struct GGGGC_PoolFragmentation *pools,
+    ggc_size_t count, ggc_size_t words)
+{
+    ggc_size_t i, c = 0, ret = 0;
+    while (words >>= 1) c++;
+    for (i = 0; i < count; i++) ret += pools[i].sizeClasses[c];
+    return ret;
+}
+
+int main(int argc, char **argv)
+{
+    Cell list = NULL, cell = NULL, tail = NULL;
+    GGC_long_Array array = NULL;
+    static struct GGGGC_PoolFragmentation pools[POOLS];
+    struct GGGGC_Stats stats;
+    ggc_size_t count;
+    long cells, i;
+
+    GGC_PUSH_4(list, cell, tail, array);
+
+    cells = (argc > 1) ? atol(argv[1]) : 100000;
+
+    for (i = 0; i < cells; i++) {
+        cell = GGC_NEW(Cell);
+        GGC_WD(cell, val, i);
+        /* keep every other one */
+        if (i % 2) continue;
+        GGC_WP(cell, next, list);
+        list = cell;
+    }
+    cell = NULL;
+
+    /* every hole is a single Cell, between two survivors */
+    GGC_COLLECT();
+    count = GGC_FRAGMENTATION(pools, POOLS);
+    if (count > POOLS) count = POOLS;
+    GGC_REPORT_FRAGMENTATION();
+    ggggc_getStats(&stats);
+    if (sizeClass(pools, count, GGGGC_WORD_SIZEOF(struct Cell__ggggc_struct)) <
+            (ggc_size_t) cells / 2 - 1) {
+        fprintf(stderr, "ERROR! The dead Cells weren't all on the free list!\n");
+        return 1;
+    }
+    if (stats.largestFreeRunBytes > 4 * sizeof(struct Cell__ggggc_struct) ||
+        stats.fragmentationPercent < 90) {
+        fprintf(stderr, "ERROR! Holes measured as %lu%% fragmented, the "
+                        "largest %lu bytes!\n",
+            (unsigned long) stats.fragmentationPercent,
+            (unsigned long) stats.largestFreeRunBytes);
+        return 1;
+    }
+
+    /* now drop all but the newest quarter, which leaves the oldest three
+     * quarters as one run */
+    cell = list;
+    for (i = 0; i < cells / 8; i++) cell = GGC_RP(cell, next);
+    GGC_WP(cell, next, tail);
+    cell = NULL;
+
+    GGC_COLLECT();
+    GGC_REPORT_FRAGMENTATION();
+    ggggc_getStats(&stats);
+    if (stats.largestFreeRunBytes < (ggc_size_t) cells / 2 *
+            sizeof(struct Cell__ggggc_struct) || stats.fragmentationPercent > 50) {
+        fprintf(stderr, "ERROR! A gap measured as %lu%% fragmented, the "
+                        "largest run %lu bytes!\n",
+            (unsigned long) stats.fragmentationPercent,
+            (unsigned long) stats.largestFreeRunBytes);
+        return 1;
+    }
+
+    /* start over, leaving a dead Cell and a dead array (with its descriptor
+     * between them) between each two survivors. A dead descriptor is only
+     * freed once the sweep is done, so it splits them into separate runs. */
+    list = NULL;
+    GGC_COLLECT();
+    for (i = 0; i < cells / 2; i++) {
+        cell = GGC_NEW(Cell);
+        GGC_WP(cell, next, list);
+        list = cell;
+        cell = GGC_NEW(Cell);
+        array = GGC_NEW_DA(long, 2);
+    }
+    cell = NULL;
+    array = NULL;
+
+    GGC_COLLECT();
+    count = GGC_FRAGMENTATION(pools, POOLS);
+    if (count > POOLS) count = POOLS;
+    for (i = 0; i < (long) count; i++) {
+        if (pools[i].runs < pools[i].entries ||
+            pools[i].largestRunBytes >= sizeof(struct Cell__ggggc_struct) +
+                sizeof(struct long__ggggc_darray) + sizeof(long)) {
+            fprintf(stderr, "ERROR! %lu free objects around dead descriptors "
+                            "measured as %lu runs, the largest %lu bytes!\n",
+                (unsigned long) pools[i].entries, (unsigned long) pools[i].runs,
+                (unsigned long) pools[i].largestRunBytes);
+            return 1;
+        }
+    }
+
+    return 0;
+}
@@ -70,7 +70,7 @@ stats_rtclock( void )
 }
 
 static const int kStretchTreeDepth    = 18;      // about 16Mb
-static const int kLongLivedTreeDepth  = 16;  // about 4Mb
+static int kLongLivedTreeDepth  = 16;  // about 4Mb, or argv[1]
 static const int kArraySize  = 500000;  // about 4Mb
 static const int kMinTreeDepth = 4;
 static const int kMaxTreeDepth = 16;
@@ -158,6 +158,26 @@ static void PrintDiagnostics() {
 #endif
 }
 
+/* with GGGGC_COUNTERS=1 in the environment, what the hardware saw in a phase */
+static void PrintCounters(const char *phase, struct GGGGC_Counters *c) {
+        printf("%s:", phase);
+        if (c->cycles != GGGGC_COUNTER_UNAVAILABLE)
+                printf(" %llu cycles", c->cycles);
+        if (c->instructions != GGGGC_COUNTER_UNAVAILABLE) {
+                printf(" %llu instructions", c->instructions);
+                if (c->cycles != GGGGC_COUNTER_UNAVAILABLE && c->cycles)
+                        printf(" (%.2f IPC)",
+                               (double) c->instructions / c->cycles);
+        }
+        if (c->l1dMisses != GGGGC_COUNTER_UNAVAILABLE)
+                printf(", %llu L1D misses", c->l1dMisses);
+        if (c->llcMisses != GGGGC_COUNTER_UNAVAILABLE)
+                printf(", %llu LLC misses", c->llcMisses);
+        if (c->dtlbMisses != GGGGC_COUNTER_UNAVAILABLE)
+                printf(", %llu dTLB misses", c->dtlbMisses);
+        printf("\n");
+}
+
 static void TimeConstruction(int depth) {
         long    tStart, tFinish;
         int     iNumIters = NumIters(depth);
@@ -191,7 +211,7 @@ static void TimeConstruction(int depth) {
 
 }
 
-int main() {
+int main(int argc, char **argv) {
         Node    root = NULL;
         Node    longLivedTree = NULL;
         Node    tempTree = NULL;
@@ -202,6 +222,18 @@ int main() {
 
         GGC_PUSH_4(root, longLivedTree, tempTree, array);
 
+        /* a deeper long-lived tree gives a larger live set to mark */
+        if (argc > 1)
+                kLongLivedTreeDepth = atoi(argv[1]);
+
+        /* and a heap growth percentage trades memory for fewer collections */
+        if (argc > 2)
+                GGC_SET_HEAP_POLICY(0, 0, atoi(argv[2]));
+
+        /* or let the pacer pick, given a pause target (usec) and GC CPU % */
+        if (argc > 3)
+                GGC_SET_PACER(atoi(argv[3]), (argc > 4) ? atoi(argv[4]) : 0);
+
 	printf("Garbage Collector Test\n");
  	printf(" Live storage will peak at %d bytes.\n\n",
                (int) (2 * sizeof(Node) * TreeSize(kLongLivedTreeDepth) +
@@ -248,6 +280,36 @@ int main() {
         tElapsed = elapsedTime(tFinish-tStart);
         PrintDiagnostics();
         printf("Completed in %d msec\n", (int) tElapsed);
+        {
+                struct GGGGC_Stats stats;
+                GGC_GET_STATS(&stats);
+                printf("Completed %lu collections\n",
+                       (unsigned long) stats.collections);
+                printf("Heap size is %lu\n",
+                       (unsigned long) (stats.poolCount * GGGGC_POOL_BYTES));
+                printf("Last pause %lu usec (predicted %lu usec), "
+                       "%lu%% of time collecting\n",
+                       (unsigned long) stats.lastPauseNs / 1000,
+                       (unsigned long) stats.predictedPauseNs / 1000,
+                       (unsigned long) stats.gcCpuPercent);
+                printf("Collecting took %lu msec: roots %lu, mark %lu, "
+                       "sweep %lu\n",
+                       (unsigned long) stats.totalPauseNs / 1000000,
+                       (unsigned long) stats.totalRootScanNs / 1000000,
+                       (unsigned long) stats.totalMarkNs / 1000000,
+                       (unsigned long) stats.totalSweepNs / 1000000);
+                printf("Pauses: p50 %lu usec, p99 %lu usec, p99.9 %lu usec\n",
+                       (unsigned long) GGC_PAUSE_PERCENTILE(0.5) / 1000,
+                       (unsigned long) GGC_PAUSE_PERCENTILE(0.99) / 1000,
+                       (unsigned long) GGC_PAUSE_PERCENTILE(0.999) / 1000);
+        }
+        {
+                struct GGGGC_Counters mark, sweep;
+                if (GGC_COUNTERS(&mark, &sweep)) {
+                        PrintCounters("Mark", &mark);
+                        PrintCounters("Sweep", &sweep);
+                }
+        }
 #	ifdef LIBGC
 	  printf("Completed %d collections\n", GC_gc_no);
 	  printf("Heap size is %d\n", GC_get_heap_size());
@@ -0,0 +1,203 @@
+/*
+ * Dumps a heap with a known shape, a global list, a list on the stack and
+ * some arrays, and checks that the dump has every object and root, and that
+ * tools/ggggc-heap (built by the top-level make tools) groups them by type.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ggggc/gc.h"
+#include "ggggc/dump.h"
+
+GGC_TYPE(Cell)
+    GGC_MPTR(Cell, next);
+    GGC_MDATA(long, val);
+GGC_END_TYPE(Cell,
+    GGC_PTR(Cell, next)
+    )
+
+static Cell global = NULL;
+
+/* build a list of the given length */
+static Cell build(long length)
+{
+    Cell list = NULL, cell = NULL;
+    long i;
+
+    GGC_PUSH_2(list, cell);
+
+    for (i = 0; i < length; i++) {
+        cell = GGC_NEW(Cell);
+        GGC_WD(cell, val, i);
+        GGC_WP(cell, next, list);
+        list = cell;
+    }
+
+    return list;
+}
+
+static void makeGlobal()
+{
+    GGC_PUSH_1(global);
+    GGC_GLOBALIZE();
+    global = build(1000);
+}
+
+/* run the analyzer on the dump, and check its table of types */
+static int analyze(const char *path)
+{
+    char command[1024], line[256], name[128];
+    unsigned long objects, bytes, retained, cells = 0, arrays = 0;
+    int inTable = 0, arrayRows = 0;
+    FILE *out;
+
+    snprintf(command, sizeof(command), "../tools/ggggc-heap %s", path);
+    out = popen(command, "r");
+    if (!out) {
+        perror(command);
+        return 0;
+    }
+    while (fgets(line, sizeof(line), out)) {
+        if (strstr(line, "retained  type")) {
+            inTable = 1;
+            continue;
+        }
+        if (!inTable) continue;
+        if (sscanf(line, "%lu %lu %lu %127[^\n]", &objects, &bytes, &retained,
+                name) != 4)
+            break;
+        if (!strcmp(name, "Cell")) cells = objects;
+        if (!strcmp(name, "(data arrays)")) {
+            arrayRows++;
+            arrays = objects;
+        }
+    }
+    if (pclose(out)) {
+        fprintf(stderr, "ERROR! %s failed!\n", command);
+        return 0;
+    }
+
+    if (cells != 1500 || arrayRows != 1 || arrays != 2000) {
+        fprintf(stderr, "ERROR! The analyzer found %lu Cells and %lu data "
+                        "arrays in %d rows, expected 1500 and 2000 in 1!\n",
+            cells, arrays, arrayRows);
+        return 0;
+    }
+    return 1;
+}
+
+static ggc_size_t readWord(FILE *in)
+{
+    ggc_size_t ret = 0;
+    if (fread(&ret, sizeof(ret), 1, in) != 1) {
+        fprintf(stderr, "ERROR! The dump is truncated!\n");
+        exit(1);
+    }
+    return ret;
+}
+
+int main(int argc, char **argv)
+{
+    Cell local = NULL;
+    GGC_voidpArray arrays = NULL;
+    GGC_long_Array array = NULL;
+    const char *path;
+    struct GGGGC_DumpHeader header;
+    ggc_size_t tag, cellDescriptor = 0, cells = 0, edges = 0;
+    ggc_size_t stackRoots = 0, globalRoots = 0, i;
+    FILE *in;
+
+    GGC_PUSH_3(local, arrays, array);
+
+    path = (argc > 1) ? argv[1] : "heapdump.dump";
+
+    makeGlobal();
+    local = build(500);
+
+    /* each with its own descriptor */
+    arrays = GGC_NEW_PA(GGC_voidp, 2000);
+    for (i = 0; i < 2000; i++) {
+        array = GGC_NEW_DA(long, 4);
+        GGC_WAP(arrays, i, array);
+    }
+    array = NULL;
+    build(10000); /* garbage, which shouldn't be dumped */
+
+    if (!GGC_DUMP_HEAP(path)) return 1;
+
+    in = fopen(path, "rb");
+    if (!in || fread(&header, sizeof(header), 1, in) != 1 ||
+        memcmp(header.magic, GGGGC_DUMP_MAGIC, sizeof(header.magic))) {
+        fprintf(stderr, "ERROR! Couldn't read the dump back!\n");
+        return 1;
+    }
+
+    while ((tag = readWord(in)) != GGGGC_DUMP_END) {
+        ggc_size_t descriptor, count, kind, word;
+        char name[64];
+
+        switch (tag) {
+            case GGGGC_DUMP_TYPE:
+                descriptor = readWord(in);
+                count = readWord(in);
+                memset(name, 0, sizeof(name));
+                count = (count + sizeof(word) - 1) / sizeof(word);
+                for (i = 0; i < count; i++) {
+                    word = readWord(in);
+                    if ((i + 1) * sizeof(word) <= sizeof(name))
+                        memcpy(name + i * sizeof(word), &word, sizeof(word));
+                }
+                if (!strcmp(name, "Cell")) cellDescriptor = descriptor;
+                break;
+
+            case GGGGC_DUMP_OBJECT:
+                readWord(in);
+                descriptor = readWord(in);
+                readWord(in);
+                count = readWord(in);
+                for (i = 0; i < count; i++) readWord(in);
+                if (descriptor == cellDescriptor) {
+                    cells++;
+                    edges += count;
+                }
+                break;
+
+            case GGGGC_DUMP_ROOT:
+                kind = readWord(in);
+                readWord(in);
+                readWord(in);
+                if (kind == GGGGC_DUMP_ROOT_GLOBAL) globalRoots++;
+                else stackRoots++;
+                break;
+
+            default:
+                fprintf(stderr, "ERROR! Unknown record %lu!\n",
+                    (unsigned long) tag);
+                return 1;
+        }
+    }
+    fclose(in);
+
+    /* every Cell points to its descriptor, and all but the last of each list
+     * to the next */
+    if (cells != 1500 || edges != 2 * 1500 - 2) {
+        fprintf(stderr, "ERROR! Dumped %lu Cells with %lu edges, expected "
+                        "1500 with 2998!\n",
+            (unsigned long) cells, (unsigned long) edges);
+        return 1;
+    }
+    if (!globalRoots || !stackRoots) {
+        fprintf(stderr, "ERROR! Expected both stack and global roots!\n");
+        return 1;
+    }
+
+    if (!analyze(path)) return 1;
+
+    printf("Dumped %lu Cells, %lu stack roots, %lu global roots\n",
+        (unsigned long) cells, (unsigned long) stackRoots,
+        (unsigned long) globalRoots);
+
+    return 0;
+}
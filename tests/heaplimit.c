@@ -0,0 +1,103 @@
+/*
+ * Checks the hard heap limit: a list is grown until the heap is exhausted,
+ * which must run emergency collections and the OOM handler before
+ * GGC_TRY_NEW gives up, and dropping the list must make room again.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "ggggc/gc.h"
+
+GGC_TYPE(Cell)
+    GGC_MPTR(Cell, next);
+    GGC_MDATA(long, val);
+GGC_END_TYPE(Cell,
+    GGC_PTR(Cell, next)
+    )
+
+static Cell cache = NULL;
+static int handlerCalls = 0;
+
+/* the first time we run out, let go of the cache */
+static int dropCache(ggc_size_t bytes)
+{
+    handlerCalls++;
+    if (cache) {
+        cache = NULL;
+        return 1;
+    }
+    return 0;
+}
+
+/* build a list of the given length, or stop early if the heap runs out */
+static long build(Cell *list, long length)
+{
+    Cell cell = NULL;
+    long i;
+
+    GGC_PUSH_1(cell);
+
+    for (i = 0; i < length; i++) {
+        cell = GGC_TRY_NEW(Cell);
+        if (!cell) break;
+        GGC_WD(cell, val, i);
+        GGC_WP(cell, next, *list);
+        *list = cell;
+    }
+
+    return i;
+}
+
+int main(int argc, char **argv)
+{
+    Cell list = NULL;
+    struct GGGGC_Config config;
+    struct GGGGC_Stats stats;
+    long built, i, cached, limit;
+
+    /* main's frame outlives everything, so the cache can be rooted here */
+    GGC_PUSH_2(list, cache);
+
+    limit = (argc > 1) ? atol(argv[1]) : 4;
+
+    GGC_GET_CONFIG(&config);
+    config.heapLimit = limit * GGGGC_POOL_BYTES;
+    GGC_INIT(&config);
+    GGC_SET_OOM_HANDLER(dropCache);
+
+    /* a cache the handler can give up */
+    cached = build(&cache, 100000);
+
+    /* grow until the heap is exhausted */
+    built = build(&list, 1L << 40);
+    GGC_GET_STATS(&stats);
+    printf("Built %ld cells in a %ld pool heap, %lu emergency collections\n",
+        built, (long) stats.poolCount, (unsigned long) stats.emergencyCollections);
+
+    if (stats.poolCount > limit) {
+        fprintf(stderr, "ERROR! The heap grew past its limit!\n");
+        return 1;
+    }
+    if (!stats.emergencyCollections || handlerCalls != 2 || cache) {
+        fprintf(stderr, "ERROR! The OOM handler wasn't used!\n");
+        return 1;
+    }
+
+    /* the list must be intact */
+    for (i = built - 1; list; i--, list = GGC_RP(list, next)) {
+        if (GGC_RD(list, val) != i) {
+            fprintf(stderr, "ERROR! The list is corrupt!\n");
+            return 1;
+        }
+    }
+
+    /* and with it gone, there's room again */
+    if (build(&list, cached) != cached) {
+        fprintf(stderr, "ERROR! The heap didn't recover!\n");
+        return 1;
+    }
+
+    printf("Heap limit respected\n");
+    return 0;
+}
@@ -0,0 +1,97 @@
+/*
+ * Simulates an event loop: each "request" builds some garbage, and the idle
+ * time between requests is given to the collector. Most collections should
+ * then happen in idle time, and the long-lived data must survive sweeps that
+ * are interleaved with allocation.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "ggggc/gc.h"
+
+GGC_TYPE(Cell)
+    GGC_MPTR(Cell, next);
+    GGC_MDATA(long, val);
+GGC_END_TYPE(Cell,
+    GGC_PTR(Cell, next)
+    )
+
+/* build a list of the given length */
+static Cell build(long length)
+{
+    Cell list = NULL, cell = NULL;
+    long i;
+
+    GGC_PUSH_2(list, cell);
+
+    for (i = 0; i < length; i++) {
+        cell = GGC_NEW(Cell);
+        GGC_WD(cell, val, i);
+        GGC_WP(cell, next, list);
+        list = cell;
+    }
+
+    return list;
+}
+
+/* check that a list built by build is intact */
+static int check(Cell list, long length)
+{
+    long i;
+    for (i = length - 1; list; i--, list = GGC_RP(list, next))
+        if (GGC_RD(list, val) != i) return 0;
+    return i == -1;
+}
+
+int main(int argc, char **argv)
+{
+    Cell longLived = NULL, temp = NULL;
+    struct GGGGC_Stats stats;
+    long requests, budget, i, sweepsLeft = 0;
+
+    GGC_PUSH_2(longLived, temp);
+
+    requests = (argc > 1) ? atol(argv[1]) : 2000;
+    budget = (argc > 2) ? atol(argv[2]) : 20000;
+
+    longLived = build(250000);
+
+    for (i = 0; i < requests; i++) {
+        temp = build(10000 + i % 1000);
+        if (!check(temp, 10000 + i % 1000)) {
+            fprintf(stderr, "ERROR! Temporary list %ld is corrupt!\n", i);
+            return 1;
+        }
+        temp = NULL;
+
+        /* idle until the next request, leaving whatever sweeping doesn't
+         * fit to the next idle period or to allocation */
+        if (GGC_COLLECT_IDLE(budget)) sweepsLeft++;
+    }
+
+    if (!check(longLived, 250000)) {
+        fprintf(stderr, "ERROR! Long-lived list is corrupt!\n");
+        return 1;
+    }
+
+    GGC_GET_STATS(&stats);
+    printf("%lu collections, %lu in idle time, %ld left sweeping\n",
+        (unsigned long) stats.collections,
+        (unsigned long) stats.idleCollections, sweepsLeft);
+    if (stats.idleCollections * 2 < stats.collections) {
+        fprintf(stderr, "ERROR! Most collections weren't in idle time!\n");
+        return 1;
+    }
+
+    /* and a full collection on request */
+    GGC_COLLECT();
+    GGC_GET_STATS(&stats);
+    if (stats.liveBytes < 250000 * sizeof(struct Cell__ggggc_struct)) {
+        fprintf(stderr, "ERROR! Live data went missing!\n");
+        return 1;
+    }
+
+    printf("Idle collection works\n");
+    return 0;
+}
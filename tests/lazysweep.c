@@ -0,0 +1,58 @@
+/*
+ * Every array has its own descriptor, which can die with it. Leaves a dead
+ * array's descriptor at the end of one pool and its body in the next, starts
+ * a lazy sweep, and reuses the first pool before the second is swept. The
+ * second pool's sweep still needs that descriptor's size.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "ggggc/gc.h"
+
+GGC_TYPE(Cell)
+    GGC_MPTR(Cell, next);
+    GGC_MDATA(long, val);
+GGC_END_TYPE(Cell,
+    GGC_PTR(Cell, next)
+    )
+
+int main(void)
+{
+    Cell first = NULL, last = NULL;
+    GGC_long_Array array = NULL;
+    long i, length;
+
+    GGC_PUSH_3(first, last, array);
+
+    first = GGC_NEW(Cell);
+    GGC_WD(first, val, 1);
+
+    /* dead arrays, spanning pools */
+    for (i = 0; i < 8; i++) array = GGC_NEW_DA(long, 3 << 17);
+    array = NULL;
+
+    /* and something live after them */
+    last = GGC_NEW(Cell);
+    GGC_WD(last, val, 2);
+
+    /* mark, and sweep as little as possible */
+    GGC_COLLECT_IDLE(0);
+
+    /* then fill what the sweep has freed so far: nearly all of the first
+     * pool, including the dead descriptor at its end */
+    length = (GGGGC_POOL_BYTES - 4096) / sizeof(long);
+    array = GGC_NEW_DA(long, length);
+    for (i = 0; i < length; i++) GGC_WAD(array, i, 2);
+    array = NULL;
+
+    GGC_COLLECT();
+    GGC_COLLECT();
+
+    if (GGC_RD(first, val) != 1 || GGC_RD(last, val) != 2) {
+        fprintf(stderr, "ERROR! Live objects were lost in a lazy sweep!\n");
+        return 1;
+    }
+    printf("Lazy sweeps kept dead descriptors until they were done\n");
+    return 0;
+}
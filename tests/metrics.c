@@ -0,0 +1,107 @@
+/*
+ * Publishes metrics, collects, and reads them back through the shared memory
+ * segment as another process would.
+ */
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "ggggc/gc.h"
+#include "ggggc/metrics.h"
+
+GGC_TYPE(Cell)
+    GGC_MPTR(Cell, next);
+GGC_END_TYPE(Cell,
+    GGC_PTR(Cell, next)
+    )
+
+int main(int argc, char **argv)
+{
+    Cell list = NULL, cell = NULL;
+    struct GGGGC_Metrics *segment, m, stuck;
+    struct GGGGC_Stats stats;
+    unsigned long long pauses = 0;
+    char name[64];
+    long collections, i, j;
+    int fd, ok;
+
+    GGC_PUSH_2(list, cell);
+
+    collections = (argc > 1) ? atol(argv[1]) : 5;
+
+    sprintf(name, "/ggggc-metrics-test.%lu", (unsigned long) getpid());
+    if (!GGC_METRICS_PUBLISH(name)) {
+        fprintf(stderr, "ERROR! Couldn't publish metrics!\n");
+        return 1;
+    }
+
+    for (i = 0; i < collections; i++) {
+        list = NULL;
+        for (j = 0; j < 100000; j++) {
+            cell = GGC_NEW(Cell);
+            GGC_WP(cell, next, list);
+            list = cell;
+        }
+        GGC_COLLECT();
+    }
+
+    fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0) {
+        perror(name);
+        return 1;
+    }
+    segment = (struct GGGGC_Metrics *) mmap(NULL,
+        sizeof(struct GGGGC_Metrics), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (segment == (struct GGGGC_Metrics *) MAP_FAILED) {
+        perror(name);
+        return 1;
+    }
+    GGGGC_METRICS_READ(&m, segment, ok);
+    GGC_GET_STATS(&stats);
+    if (!ok) {
+        fprintf(stderr, "ERROR! Couldn't read the metrics consistently!\n");
+        return 1;
+    }
+
+    if (memcmp(m.magic, GGGGC_METRICS_MAGIC, sizeof(m.magic)) ||
+        m.version != GGGGC_METRICS_VERSION || m.pid != (unsigned long long) getpid()) {
+        fprintf(stderr, "ERROR! Bad metrics header!\n");
+        return 1;
+    }
+    if (m.collections != stats.collections ||
+        m.liveBytes != stats.liveBytes ||
+        m.poolCount != stats.poolCount) {
+        fprintf(stderr, "ERROR! Published %llu collections, %llu live bytes, "
+                        "%llu pools; expected %lu, %lu, %lu!\n",
+            m.collections, m.liveBytes, m.poolCount,
+            (unsigned long) stats.collections,
+            (unsigned long) stats.liveBytes,
+            (unsigned long) stats.poolCount);
+        return 1;
+    }
+    for (i = 0; i < GGGGC_METRICS_PAUSE_BUCKETS; i++)
+        pauses += m.pauseHistogram[i];
+    if (m.pauses < (unsigned long long) collections || pauses != m.pauses) {
+        fprintf(stderr, "ERROR! %llu pauses published, %llu in the "
+                        "histogram!\n", m.pauses, pauses);
+        return 1;
+    }
+
+    /* a segment whose writer died mid-update can't be read, but mustn't hang */
+    stuck = m;
+    stuck.sequence = 1;
+    GGGGC_METRICS_READ(&m, &stuck, ok);
+    if (ok) {
+        fprintf(stderr, "ERROR! Read a segment stuck mid-update!\n");
+        return 1;
+    }
+
+    printf("Published %llu collections and %llu pauses\n", m.collections,
+        m.pauses);
+    return 0;
+}
@@ -0,0 +1,68 @@
+/*
+ * Checks that the heap shrinks after a spike: a large temporary structure is
+ * built and dropped, and after a few more collections the pools it used
+ * should have been returned to the OS.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "ggggc/gc.h"
+
+GGC_TYPE(Cell)
+    GGC_MPTR(Cell, next);
+    GGC_MDATA(long, val);
+GGC_END_TYPE(Cell,
+    GGC_PTR(Cell, next)
+    )
+
+static void report(const char *when)
+{
+    struct GGGGC_Stats stats;
+    GGC_GET_STATS(&stats);
+    printf("%s: %lu collections, %lu pools, %lu free, %lu decommitted\n",
+        when,
+        (unsigned long) stats.collections,
+        (unsigned long) stats.poolCount,
+        (unsigned long) stats.freePoolCount,
+        (unsigned long) stats.decommittedPoolCount);
+}
+
+int main(int argc, char **argv)
+{
+    Cell list = NULL, cell = NULL;
+    struct GGGGC_Config config;
+    struct GGGGC_Stats stats;
+    long i, spike;
+
+    GGC_PUSH_2(list, cell);
+
+    spike = (argc > 1) ? atol(argv[1]) : 8 * 1024 * 1024;
+
+    for (i = 0; i < spike; i++) {
+        cell = GGC_NEW(Cell);
+        GGC_WD(cell, val, i);
+        GGC_WP(cell, next, list);
+        list = cell;
+    }
+    cell = NULL;
+    report("spike");
+
+    list = NULL;
+    GGC_GET_CONFIG(&config);
+    for (i = 0; i < (long) config.decommitDelay + 1; i++)
+        GGC_COLLECT();
+    report("after");
+
+    GGC_GET_STATS(&stats);
+    if (stats.decommittedPoolCount == 0 ||
+        stats.rssAfterDecommit >= stats.rssBeforeDecommit) {
+        fprintf(stderr, "ERROR! The heap did not shrink!\n");
+        return 1;
+    }
+    printf("RSS went from %luK to %luK\n",
+        (unsigned long) stats.rssBeforeDecommit / 1024,
+        (unsigned long) stats.rssAfterDecommit / 1024);
+
+    return 0;
+}
@@ -0,0 +1,77 @@
+/*
+ * Leaks through one structure while churning through another, and checks
+ * that a snapshot diff blames the leaking one.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ggggc/gc.h"
+
+GGC_TYPE(Cell)
+    GGC_MPTR(Cell, next);
+    GGC_MDATA(long, val);
+GGC_END_TYPE(Cell,
+    GGC_PTR(Cell, next)
+    )
+
+GGC_TYPE(Cache)
+    GGC_MPTR(Cell, entries);
+GGC_END_TYPE(Cache,
+    GGC_PTR(Cache, entries)
+    )
+
+/* a "request", which leaks one Cell into the cache */
+static void request(Cache cache, long i)
+{
+    Cell cell = NULL, temp = NULL, scratch = NULL;
+    long j;
+
+    GGC_PUSH_4(cache, cell, temp, scratch);
+
+    for (j = 0; j < 100; j++) {
+        temp = GGC_NEW(Cell);
+        GGC_WP(temp, next, scratch);
+        scratch = temp;
+    }
+
+    cell = GGC_NEW(Cell);
+    GGC_WD(cell, val, i);
+    temp = GGC_RP(cache, entries);
+    GGC_WP(cell, next, temp);
+    GGC_WP(cache, entries, cell);
+}
+
+int main(int argc, char **argv)
+{
+    Cache cache = NULL;
+    struct GGGGC_SnapshotDelta deltas[8];
+    ggc_size_t count;
+    long requests, i;
+
+    GGC_PUSH_1(cache);
+
+    requests = (argc > 1) ? atol(argv[1]) : 10000;
+
+    cache = GGC_NEW(Cache);
+    for (i = 0; i < 100; i++) request(cache, i);
+    GGC_SNAPSHOT();
+    for (i = 0; i < requests; i++) request(cache, i);
+    GGC_SNAPSHOT();
+
+    count = GGC_SNAPSHOT_DIFF(deltas, 8);
+    if (!count || strcmp(deltas[0].type, "Cell") ||
+        deltas[0].objects != requests ||
+        strcmp(deltas[0].path, "Cell <- Cache <- stack frame 0")) {
+        fprintf(stderr, "ERROR! Expected %ld Cells to grow under the Cache, "
+                        "got %s%ld on %s!\n", requests,
+            count ? "" : "nothing: ", count ? deltas[0].objects : 0L,
+            count ? deltas[0].path : "no path");
+        return 1;
+    }
+
+    printf("%ld objects grew on %s\n", deltas[0].objects, deltas[0].path);
+
+    return 0;
+}
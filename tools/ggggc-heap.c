@@ -0,0 +1,600 @@
+/*
+ * Offline analyzer for GGGGC heap dumps: what's in the heap, and what's
+ * keeping it alive
+ *
+ * Copyright (c) 2014, 2015 Gregor Richards
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION
+ * OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ggggc/dump.h"
+
+/* Node 0 is a virtual root, pointing at everything the roots do; object i is
+ * node i+1. Dominators are found with the iterative algorithm of Cooper,
+ * Harvey and Kennedy, and an object's retained size is everything it
+ * dominates. */
+
+typedef unsigned long long word;
+
+/* types are by name, as every array has its own descriptor */
+struct Type {
+    char *name;
+    word objects, bytes, retained;
+};
+
+struct Root {
+    word kind, frame, target;
+};
+
+static FILE *in;
+static const char *inPath;
+static unsigned wordSize;
+
+static struct Type *types;
+static size_t typesCount, typesSize;
+
+static struct Root *roots;
+static size_t rootsCount, rootsSize;
+
+/* per node */
+static word *addrs, *sizes;
+static size_t *typeOf, *edgeStart, nodesCount, nodesSize;
+static size_t *firstRoot; /* +1, or 0 for none */
+
+/* edge targets, as addresses until they're resolved to nodes */
+static word *edges;
+static size_t edgesCount, edgesSize;
+
+/* address to node, open-addressed */
+static size_t *nodeHash, nodeHashSize;
+
+/* name to type (+1), and descriptor to type, open-addressed */
+static size_t *typeHash, typeHashSize;
+static word *descriptorKeys;
+static size_t *descriptorTypes, descriptorHashSize, descriptorCount;
+
+/* the dominator tree */
+static size_t *postorder, *rpo, rpoCount, *idom;
+static word *retained;
+
+#define UNDEFINED ((size_t) -1)
+
+static void *grow(void *ptr, size_t *size, size_t want, size_t elem)
+{
+    if (want <= *size) return ptr;
+    while (*size < want) *size = *size ? *size * 2 : 1024;
+    ptr = realloc(ptr, *size * elem);
+    if (!ptr) {
+        perror("realloc");
+        exit(1);
+    }
+    return ptr;
+}
+
+static void *allocate(size_t count, size_t elem)
+{
+    void *ret = calloc(count ? count : 1, elem);
+    if (!ret) {
+        perror("calloc");
+        exit(1);
+    }
+    return ret;
+}
+
+static word readWord()
+{
+    unsigned char buf[8];
+    if (fread(buf, wordSize, 1, in) != 1) {
+        fprintf(stderr, "%s: truncated dump\n", inPath);
+        exit(1);
+    }
+    if (wordSize == 4) {
+        unsigned int ret;
+        memcpy(&ret, buf, 4);
+        return ret;
+    } else {
+        word ret;
+        memcpy(&ret, buf, 8);
+        return ret;
+    }
+}
+
+static size_t hashOf(word addr)
+{
+    addr ^= addr >> 17;
+    addr *= 0x9E3779B97F4A7C15ULL;
+    return (size_t) (addr ^ (addr >> 29));
+}
+
+/* the node for an address, or UNDEFINED if it's not an object in the dump */
+static size_t nodeOf(word addr)
+{
+    size_t i = hashOf(addr) & (nodeHashSize - 1);
+    while (nodeHash[i]) {
+        if (addrs[nodeHash[i]] == addr) return nodeHash[i];
+        i = (i + 1) & (nodeHashSize - 1);
+    }
+    return UNDEFINED;
+}
+
+static size_t hashOfName(const char *name)
+{
+    size_t h = 5381;
+    while (*name) h = h * 33 + (unsigned char) *name++;
+    return h;
+}
+
+static size_t *typeSlot(const char *name)
+{
+    size_t i = hashOfName(name) & (typeHashSize - 1);
+    while (typeHash[i] && strcmp(types[typeHash[i] - 1].name, name))
+        i = (i + 1) & (typeHashSize - 1);
+    return &typeHash[i];
+}
+
+/* the type with this name, added if it's new. Takes the name. */
+static size_t internType(char *name)
+{
+    size_t *slot;
+
+    if ((typesCount + 1) * 2 > typeHashSize) {
+        size_t i;
+        free(typeHash);
+        typeHashSize = typeHashSize ? typeHashSize * 2 : 64;
+        typeHash = (size_t *) allocate(typeHashSize, sizeof(size_t));
+        for (i = 0; i < typesCount; i++) *typeSlot(types[i].name) = i + 1;
+    }
+
+    slot = typeSlot(name);
+    if (*slot) {
+        free(name);
+        return *slot - 1;
+    }
+    types = (struct Type *) grow(types, &typesSize, typesCount + 1,
+        sizeof(struct Type));
+    memset(&types[typesCount], 0, sizeof(struct Type));
+    types[typesCount].name = name;
+    *slot = ++typesCount;
+    return typesCount - 1;
+}
+
+static size_t descriptorSlot(word descriptor)
+{
+    size_t i = hashOf(descriptor) & (descriptorHashSize - 1);
+    while (descriptorKeys[i] && descriptorKeys[i] != descriptor)
+        i = (i + 1) & (descriptorHashSize - 1);
+    return i;
+}
+
+static void setTypeOf(word descriptor, size_t type)
+{
+    size_t i, j;
+
+    if ((descriptorCount + 1) * 2 > descriptorHashSize) {
+        word *oldKeys = descriptorKeys;
+        size_t *oldTypes = descriptorTypes, oldSize = descriptorHashSize;
+        descriptorHashSize = descriptorHashSize ? descriptorHashSize * 2 : 64;
+        descriptorKeys = (word *) allocate(descriptorHashSize, sizeof(word));
+        descriptorTypes = (size_t *)
+            allocate(descriptorHashSize, sizeof(size_t));
+        for (i = 0; i < oldSize; i++) {
+            if (!oldKeys[i]) continue;
+            j = descriptorSlot(oldKeys[i]);
+            descriptorKeys[j] = oldKeys[i];
+            descriptorTypes[j] = oldTypes[i];
+        }
+        free(oldKeys);
+        free(oldTypes);
+    }
+
+    i = descriptorSlot(descriptor);
+    if (!descriptorKeys[i]) descriptorCount++;
+    descriptorKeys[i] = descriptor;
+    descriptorTypes[i] = type;
+}
+
+static size_t typeNamed(word descriptor)
+{
+    size_t i;
+    if (!descriptorHashSize) return UNDEFINED;
+    i = descriptorSlot(descriptor);
+    return descriptorKeys[i] ? descriptorTypes[i] : UNDEFINED;
+}
+
+/* read the whole dump */
+static void readDump()
+{
+    struct GGGGC_DumpHeader header;
+    size_t i;
+    word tag;
+
+    if (fread(&header, sizeof(header), 1, in) != 1 ||
+        memcmp(header.magic, GGGGC_DUMP_MAGIC, sizeof(header.magic))) {
+        fprintf(stderr, "%s: not a GGGGC heap dump\n", inPath);
+        exit(1);
+    }
+    if (header.version != GGGGC_DUMP_VERSION ||
+        (header.wordSize != 4 && header.wordSize != 8)) {
+        fprintf(stderr, "%s: unsupported dump version %u (word size %u)\n",
+            inPath, header.version, header.wordSize);
+        exit(1);
+    }
+    wordSize = header.wordSize;
+
+    /* node 0 is the virtual root */
+    nodesCount = 1;
+    addrs = (word *) grow(NULL, &nodesSize, 1, sizeof(word));
+    sizes = (word *) allocate(nodesSize, sizeof(word));
+    typeOf = (size_t *) allocate(nodesSize, sizeof(size_t));
+    edgeStart = (size_t *) allocate(nodesSize + 1, sizeof(size_t));
+    addrs[0] = sizes[0] = 0;
+    typeOf[0] = UNDEFINED;
+
+    while ((tag = readWord()) != GGGGC_DUMP_END) {
+        switch (tag) {
+            case GGGGC_DUMP_TYPE: {
+                word descriptor, length, padded;
+                char *name;
+                descriptor = readWord();
+                length = readWord();
+                padded = (length + wordSize - 1) / wordSize * wordSize;
+                name = (char *) allocate(padded + 1, 1);
+                if (padded && fread(name, padded, 1, in) != 1) {
+                    fprintf(stderr, "%s: truncated dump\n", inPath);
+                    exit(1);
+                }
+                name[length] = 0;
+                setTypeOf(descriptor, internType(name));
+                break;
+            }
+
+            case GGGGC_DUMP_OBJECT: {
+                size_t oldSize = nodesSize, node = nodesCount++;
+                word descriptor, count;
+                addrs = (word *) grow(addrs, &nodesSize, nodesCount,
+                    sizeof(word));
+                if (nodesSize != oldSize) {
+                    size_t s = oldSize;
+                    sizes = (word *) grow(sizes, &s, nodesSize, sizeof(word));
+                    s = oldSize;
+                    typeOf = (size_t *) grow(typeOf, &s, nodesSize,
+                        sizeof(size_t));
+                    s = oldSize + 1;
+                    edgeStart = (size_t *) grow(edgeStart, &s, nodesSize + 1,
+                        sizeof(size_t));
+                }
+                addrs[node] = readWord();
+                descriptor = readWord();
+                sizes[node] = readWord() * wordSize;
+                typeOf[node] = typeNamed(descriptor);
+                count = readWord();
+                edgeStart[node] = edgesCount;
+                edges = (word *) grow(edges, &edgesSize, edgesCount + count,
+                    sizeof(word));
+                for (i = 0; i < count; i++) edges[edgesCount++] = readWord();
+                break;
+            }
+
+            case GGGGC_DUMP_ROOT: {
+                struct Root *root;
+                roots = (struct Root *) grow(roots, &rootsSize, rootsCount + 1,
+                    sizeof(struct Root));
+                root = &roots[rootsCount++];
+                root->kind = readWord();
+                root->frame = readWord();
+                root->target = readWord();
+                break;
+            }
+
+            default:
+                fprintf(stderr, "%s: unknown record %llu\n", inPath, tag);
+                exit(1);
+        }
+    }
+    edgeStart[nodesCount] = edgesCount;
+}
+
+/* turn edge addresses into nodes, and attach the roots to node 0 */
+static void buildGraph()
+{
+    size_t i, node;
+    word *objectEdges = edges;
+    size_t *objectStart = edgeStart;
+
+    nodeHashSize = 1;
+    while (nodeHashSize < nodesCount * 2) nodeHashSize *= 2;
+    nodeHash = (size_t *) allocate(nodeHashSize, sizeof(size_t));
+    for (node = 1; node < nodesCount; node++) {
+        size_t h = hashOf(addrs[node]) & (nodeHashSize - 1);
+        while (nodeHash[h]) h = (h + 1) & (nodeHashSize - 1);
+        nodeHash[h] = node;
+    }
+
+    /* node 0's edges are the roots, so rebuild the edge list with them
+     * first */
+    edges = (word *) allocate(rootsCount + edgesCount, sizeof(word));
+    edgeStart = (size_t *) allocate(nodesCount + 1, sizeof(size_t));
+    firstRoot = (size_t *) allocate(nodesCount, sizeof(size_t));
+    edgesCount = 0;
+    for (i = 0; i < rootsCount; i++) {
+        node = nodeOf(roots[i].target);
+        if (node == UNDEFINED) continue;
+        if (!firstRoot[node]) firstRoot[node] = i + 1;
+        edges[edgesCount++] = node;
+    }
+    for (node = 1; node < nodesCount; node++) {
+        edgeStart[node] = edgesCount;
+        for (i = objectStart[node]; i < objectStart[node + 1]; i++) {
+            size_t target = nodeOf(objectEdges[i]);
+            if (target != UNDEFINED) edges[edgesCount++] = target;
+        }
+    }
+    edgeStart[nodesCount] = edgesCount;
+    free(objectEdges);
+    free(objectStart);
+}
+
+/* number the nodes reachable from the root in postorder */
+static void depthFirst()
+{
+    size_t *stack, *next, top = 0, counter = 0;
+
+    postorder = (size_t *) allocate(nodesCount, sizeof(size_t));
+    rpo = (size_t *) allocate(nodesCount, sizeof(size_t));
+    stack = (size_t *) allocate(nodesCount, sizeof(size_t));
+    next = (size_t *) allocate(nodesCount, sizeof(size_t));
+    memset(postorder, 0xFF, nodesCount * sizeof(size_t));
+
+    /* postorder[n] is 0 while n is on the stack, and counts from 1 after */
+    stack[top++] = 0;
+    postorder[0] = 0;
+    next[0] = edgeStart[0];
+    while (top) {
+        size_t node = stack[top - 1];
+        if (next[node] < edgeStart[node + 1]) {
+            size_t target = (size_t) edges[next[node]++];
+            if (postorder[target] == UNDEFINED) {
+                postorder[target] = 0;
+                next[target] = edgeStart[target];
+                stack[top++] = target;
+            }
+            continue;
+        }
+        top--;
+        postorder[node] = ++counter;
+        rpo[nodesCount - counter] = node;
+    }
+
+    /* move the reverse postorder to the front */
+    rpoCount = counter;
+    memmove(rpo, rpo + nodesCount - counter, counter * sizeof(size_t));
+
+    free(stack);
+    free(next);
+}
+
+static size_t intersect(size_t a, size_t b)
+{
+    while (a != b) {
+        while (postorder[a] < postorder[b]) a = idom[a];
+        while (postorder[b] < postorder[a]) b = idom[b];
+    }
+    return a;
+}
+
+static void dominators()
+{
+    size_t *predStart, *preds, *fill, i, j;
+    int changed;
+
+    /* predecessors, of reachable nodes only */
+    predStart = (size_t *) allocate(nodesCount + 1, sizeof(size_t));
+    for (i = 0; i < nodesCount; i++) {
+        if (postorder[i] == UNDEFINED) continue;
+        for (j = edgeStart[i]; j < edgeStart[i + 1]; j++)
+            predStart[edges[j] + 1]++;
+    }
+    for (i = 0; i < nodesCount; i++) predStart[i + 1] += predStart[i];
+    preds = (size_t *) allocate(predStart[nodesCount], sizeof(size_t));
+    fill = (size_t *) allocate(nodesCount, sizeof(size_t));
+    memcpy(fill, predStart, nodesCount * sizeof(size_t));
+    for (i = 0; i < nodesCount; i++) {
+        if (postorder[i] == UNDEFINED) continue;
+        for (j = edgeStart[i]; j < edgeStart[i + 1]; j++)
+            preds[fill[edges[j]]++] = i;
+    }
+    free(fill);
+
+    idom = (size_t *) allocate(nodesCount, sizeof(size_t));
+    memset(idom, 0xFF, nodesCount * sizeof(size_t));
+    idom[0] = 0;
+    do {
+        changed = 0;
+        for (i = 1; i < rpoCount; i++) {
+            size_t node = rpo[i], newIdom = UNDEFINED;
+            for (j = predStart[node]; j < predStart[node + 1]; j++) {
+                size_t pred = preds[j];
+                if (idom[pred] == UNDEFINED) continue;
+                newIdom = (newIdom == UNDEFINED) ? pred :
+                    intersect(pred, newIdom);
+            }
+            if (idom[node] != newIdom) {
+                idom[node] = newIdom;
+                changed = 1;
+            }
+        }
+    } while (changed);
+
+    free(predStart);
+    free(preds);
+
+    /* everything a node dominates comes after it in reverse postorder */
+    retained = (word *) allocate(nodesCount, sizeof(word));
+    for (i = 0; i < nodesCount; i++) retained[i] = sizes[i];
+    for (i = rpoCount; i-- > 1;) {
+        size_t node = rpo[i];
+        retained[idom[node]] += retained[node];
+    }
+}
+
+static const char *typeName(size_t node)
+{
+    if (!node) return "(roots)";
+    if (typeOf[node] == UNDEFINED) return "(unknown)";
+    return types[typeOf[node]].name;
+}
+
+static int compareTypes(const void *l, const void *r)
+{
+    const struct Type *lt = &types[*(const size_t *) l];
+    const struct Type *rt = &types[*(const size_t *) r];
+    if (lt->retained != rt->retained)
+        return (lt->retained < rt->retained) ? 1 : -1;
+    if (lt->bytes != rt->bytes) return (lt->bytes < rt->bytes) ? 1 : -1;
+    return strcmp(lt->name, rt->name);
+}
+
+static int compareRetained(const void *l, const void *r)
+{
+    word lr = retained[*(const size_t *) l], rr = retained[*(const size_t *) r];
+    if (lr != rr) return (lr < rr) ? 1 : -1;
+    return 0;
+}
+
+/* print how an object is held: its dominators, back to a root */
+static void printChain(size_t node)
+{
+    const char *last = NULL;
+    size_t repeats = 0;
+
+    printf("    held by:");
+    while (idom[node] != 0) {
+        const char *name;
+        node = idom[node];
+        name = typeName(node);
+        if (last && !strcmp(name, last)) {
+            repeats++;
+            continue;
+        }
+        if (repeats) printf(" x%lu", (unsigned long) repeats + 1);
+        printf(" %s%s", last ? "<- " : "", name);
+        last = name;
+        repeats = 0;
+    }
+    if (repeats) printf(" x%lu", (unsigned long) repeats + 1);
+    if (firstRoot[node]) {
+        struct Root *root = &roots[firstRoot[node] - 1];
+        printf(" %s%s", last ? "<- " : "",
+            (root->kind == GGGGC_DUMP_ROOT_GLOBAL) ? "global" : "stack");
+        if (root->kind != GGGGC_DUMP_ROOT_GLOBAL)
+            printf(" frame %llu", root->frame);
+    }
+    printf("\n");
+}
+
+static void report(size_t top)
+{
+    size_t i, reachable = 0, stackRoots = 0, globalRoots = 0, *sorted;
+    word bytes = 0;
+
+    for (i = 0; i < rootsCount; i++) {
+        if (roots[i].kind == GGGGC_DUMP_ROOT_GLOBAL) globalRoots++;
+        else stackRoots++;
+    }
+
+    /* a type retains what its objects do, except where they're held by
+     * another object of the same type (e.g. the rest of a list) */
+    for (i = 1; i < nodesCount; i++) {
+        struct Type *type;
+        bytes += sizes[i];
+        if (postorder[i] != UNDEFINED) reachable++;
+        if (typeOf[i] == UNDEFINED) continue;
+        type = &types[typeOf[i]];
+        type->objects++;
+        type->bytes += sizes[i];
+        if (postorder[i] != UNDEFINED && typeOf[idom[i]] != typeOf[i])
+            type->retained += retained[i];
+    }
+
+    printf("%lu objects, %llu bytes, %lu roots (%lu stack, %lu global)\n",
+        (unsigned long) (nodesCount - 1), bytes, (unsigned long) rootsCount,
+        (unsigned long) stackRoots, (unsigned long) globalRoots);
+    if (reachable != nodesCount - 1)
+        printf("%lu objects not reachable from the roots\n",
+            (unsigned long) (nodesCount - 1 - reachable));
+
+    printf("\n%12s %14s %14s  %s\n", "objects", "bytes", "retained", "type");
+    sorted = (size_t *) allocate(typesCount, sizeof(size_t));
+    for (i = 0; i < typesCount; i++) sorted[i] = i;
+    qsort(sorted, typesCount, sizeof(size_t), compareTypes);
+    for (i = 0; i < typesCount; i++) {
+        struct Type *type = &types[sorted[i]];
+        printf("%12llu %14llu %14llu  %s\n", type->objects, type->bytes,
+            type->retained, type->name);
+    }
+    free(sorted);
+
+    printf("\nlargest retained sizes:\n%14s %10s  %s\n", "retained", "size",
+        "object");
+    sorted = (size_t *) allocate(rpoCount, sizeof(size_t));
+    for (i = 1; i < rpoCount; i++) sorted[i - 1] = rpo[i];
+    qsort(sorted, rpoCount - 1, sizeof(size_t), compareRetained);
+    for (i = 0; i < rpoCount - 1 && i < top; i++) {
+        size_t node = sorted[i];
+        printf("%14llu %10llu  %s @ 0x%llx\n", retained[node], sizes[node],
+            typeName(node), addrs[node]);
+        printChain(node);
+    }
+    free(sorted);
+}
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr, "Use: %s [-n count] <heap dump>\n", argv0);
+    exit(1);
+}
+
+int main(int argc, char **argv)
+{
+    size_t top = 10;
+    int i;
+
+    for (i = 1; i < argc - 1; i++) {
+        if (!strcmp(argv[i], "-n") && i + 1 < argc - 1) {
+            top = (size_t) atol(argv[++i]);
+        } else {
+            usage(argv[0]);
+        }
+    }
+    if (i != argc - 1) usage(argv[0]);
+
+    inPath = argv[i];
+    in = fopen(inPath, "rb");
+    if (!in) {
+        perror(inPath);
+        return 1;
+    }
+    readDump();
+    fclose(in);
+
+    buildGraph();
+    depthFirst();
+    dominators();
+    report(top);
+
+    return 0;
+}
@@ -0,0 +1,181 @@
+/*
+ * Live view of a running program's GGGGC metrics, from the shared memory
+ * segment it publishes
+ *
+ * Copyright (c) 2014, 2015 Gregor Richards
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION
+ * OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "ggggc/metrics.h"
+
+typedef unsigned long long word;
+
+/* print a byte count with a binary suffix */
+static void printBytes(const char *label, word bytes)
+{
+    static const char suffixes[] = "KMGT";
+    double value = bytes;
+    int suffix = -1;
+    while (value >= 1024 && suffix < 3) {
+        value /= 1024;
+        suffix++;
+    }
+    if (suffix < 0) printf("%s%llu", label, bytes);
+    else printf("%s%.1f%c", label, value, suffixes[suffix]);
+}
+
+static word now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (word) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void show(const char *name, struct GGGGC_Metrics *m, word previous)
+{
+    word most = 0, mean;
+    int i, first = -1, last = 0;
+
+    printf("GGGGC metrics for process %llu (%s), updated %.1f sec ago\n",
+        m->pid, name, (now() - m->updatedNs) / 1e9);
+    printf("collections %10llu", m->collections);
+    if (previous <= m->collections)
+        printf(" (%llu since last refresh)", m->collections - previous);
+    printBytes("\nheap        ", m->heapBytes);
+    printf(" in %llu pools", m->poolCount);
+    printBytes(", target ", m->heapTargetBytes);
+    printBytes("\nlive        ", m->liveBytes);
+    printBytes("\nallocated   ", m->allocatedBytes);
+    printBytes(", ", m->allocRate);
+    mean = m->pauses ? m->totalPauseNs / m->pauses : 0;
+    printf("/sec\npauses      %10llu, last %llu usec, mean %llu usec, max %llu "
+           "usec\n\n", m->pauses, m->lastPauseNs / 1000, mean / 1000,
+           m->maxPauseNs / 1000);
+
+    for (i = 0; i < GGGGC_METRICS_PAUSE_BUCKETS; i++) {
+        if (m->pauseHistogram[i] > most) most = m->pauseHistogram[i];
+        if (!m->pauseHistogram[i]) continue;
+        if (first < 0) first = i;
+        last = i;
+    }
+    printf("%20s %10s\n", "pause (usec)", "count");
+    for (i = first; i <= last && most; i++) {
+        word count = m->pauseHistogram[i];
+        int bar = (int) ((count * 40 + most - 1) / most);
+        char range[32];
+        if (i) sprintf(range, "%llu-%llu", (word) 1 << i, ((word) 2 << i) - 1);
+        else strcpy(range, "0-1");
+        printf("%20s %10llu%s", range, count, bar ? " " : "");
+        while (bar--) putchar('#');
+        putchar('\n');
+    }
+}
+
+static void usage(const char *argv0)
+{
+    fprintf(stderr, "Use: %s [-d seconds] [-n count] <pid or segment name>\n",
+        argv0);
+    exit(1);
+}
+
+int main(int argc, char **argv)
+{
+    struct GGGGC_Metrics *segment, m;
+    struct timespec delay;
+    double seconds = 1;
+    long count = -1;
+    char name[256];
+    word previous = (word) -1;
+    int i, fd, tty;
+
+    for (i = 1; i < argc - 1; i++) {
+        if (!strcmp(argv[i], "-d") && i + 1 < argc - 1) {
+            seconds = atof(argv[++i]);
+        } else if (!strcmp(argv[i], "-n") && i + 1 < argc - 1) {
+            count = atol(argv[++i]);
+        } else {
+            usage(argv[0]);
+        }
+    }
+    if (i != argc - 1) usage(argv[0]);
+
+    /* a process ID means its default segment */
+    if (isdigit((unsigned char) argv[i][0]))
+        snprintf(name, sizeof(name), GGGGC_METRICS_PREFIX "%s", argv[i]);
+    else
+        snprintf(name, sizeof(name), "%s", argv[i]);
+
+    fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0) {
+        perror(name);
+        return 1;
+    }
+    segment = (struct GGGGC_Metrics *) mmap(NULL,
+        sizeof(struct GGGGC_Metrics), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (segment == (struct GGGGC_Metrics *) MAP_FAILED) {
+        perror(name);
+        return 1;
+    }
+    if (memcmp(segment->magic, GGGGC_METRICS_MAGIC, sizeof(segment->magic)) ||
+        segment->version != GGGGC_METRICS_VERSION) {
+        fprintf(stderr, "%s: not a version %d GGGGC metrics segment\n", name,
+            GGGGC_METRICS_VERSION);
+        return 1;
+    }
+
+    tty = isatty(1);
+    delay.tv_sec = (time_t) seconds;
+    delay.tv_nsec = (long) ((seconds - delay.tv_sec) * 1e9);
+    while (count) {
+        int ok, alive;
+
+        GGGGC_METRICS_READ(&m, segment, ok);
+        alive = !kill((pid_t) segment->pid, 0) || errno != ESRCH;
+
+        /* a writer killed mid-update never finishes it */
+        if (!ok) {
+            if (!alive) {
+                printf("process %llu has exited\n", segment->pid);
+                break;
+            }
+            if (!--count) break;
+            nanosleep(&delay, NULL);
+            continue;
+        }
+
+        if (tty) printf("\033[H\033[J");
+        show(name, &m, previous);
+        if (!alive) printf("\nprocess %llu has exited\n", m.pid);
+        else if (!tty) printf("\n");
+        fflush(stdout);
+        previous = m.collections;
+
+        if (!alive || !--count) break;
+        nanosleep(&delay, NULL);
+    }
+
+    return 0;
+}
@@ -0,0 +1,149 @@
+/*
+ * Chrome trace-event output
+ *
+ * Copyright (c) 2014, 2015 Gregor Richards
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION
+ * OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+
+/* for standards info */
+#if defined(unix) || defined(__unix) || defined(__unix__) || \
+    (defined(__APPLE__) && defined(__MACH__))
+#include <unistd.h>
+#endif
+
+#include "ggggc/gc.h"
+#include "ggggc-internals.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Events go into a ring buffer, overwriting the oldest when it's full, and
+ * are only formatted when flushed. The collector is single-threaded, so
+ * recording an event is just a few stores. */
+struct GGGGC_TraceEvent {
+    const char *name;
+    const char *argName; /* NULL for no argument */
+    ggc_size_t start, duration, arg;
+    char phase; /* 'X' for a span, 'i' for an instant */
+};
+
+int ggggc_tracing;
+static struct GGGGC_TraceEvent *events;
+static ggc_size_t eventsNext, traceBase;
+static char *tracePath;
+
+/* record an event */
+static void record(char phase, const char *name, ggc_size_t start,
+    ggc_size_t duration, const char *argName, ggc_size_t arg)
+{
+    struct GGGGC_TraceEvent *ev = &events[eventsNext++ % GGGGC_TRACE_EVENTS];
+    ev->name = name;
+    ev->argName = argName;
+    ev->start = start;
+    ev->duration = duration;
+    ev->arg = arg;
+    ev->phase = phase;
+}
+
+void ggggc_traceSpan(const char *name, ggc_size_t start, ggc_size_t end,
+    const char *argName, ggc_size_t arg)
+{
+    record('X', name, start, end - start, argName, arg);
+}
+
+void ggggc_traceInstant(const char *name, const char *argName, ggc_size_t arg)
+{
+    record('i', name, ggggc_now(), 0, argName, arg);
+}
+
+/* write out everything in the buffer */
+void ggggc_traceFlush()
+{
+    FILE *out;
+    ggc_size_t i, pid = 0;
+    const char *sep = "";
+
+    if (!events) return;
+
+    out = fopen(tracePath, "w");
+    if (!out) {
+        perror(tracePath);
+        return;
+    }
+
+#if _POSIX_VERSION
+    pid = (ggc_size_t) getpid();
+#endif
+
+    fprintf(out, "{\"traceEvents\":[\n");
+    i = (eventsNext > GGGGC_TRACE_EVENTS) ? eventsNext - GGGGC_TRACE_EVENTS : 0;
+    for (; i < eventsNext; i++) {
+        struct GGGGC_TraceEvent *ev = &events[i % GGGGC_TRACE_EVENTS];
+        fprintf(out, "%s{\"name\":\"%s\",\"cat\":\"gc\",\"ph\":\"%c\","
+                     "\"ts\":%.3f,\"pid\":%lu,\"tid\":1",
+            sep, ev->name, ev->phase, (ev->start - traceBase) / 1000.0,
+            (unsigned long) pid);
+        if (ev->phase == 'X')
+            fprintf(out, ",\"dur\":%.3f", ev->duration / 1000.0);
+        else
+            fprintf(out, ",\"s\":\"t\"");
+        if (ev->argName)
+            fprintf(out, ",\"args\":{\"%s\":%lu}", ev->argName,
+                (unsigned long) ev->arg);
+        fprintf(out, "}");
+        sep = ",\n";
+    }
+    fprintf(out, "\n]}\n");
+    fclose(out);
+}
+
+/* start tracing to the given file */
+void ggggc_traceStart(const char *path)
+{
+    static int flushing = 0;
+
+    if (!events) {
+        events = (struct GGGGC_TraceEvent *)
+            malloc(GGGGC_TRACE_EVENTS * sizeof(struct GGGGC_TraceEvent));
+        if (!events) {
+            perror("malloc");
+            return;
+        }
+        traceBase = ggggc_now();
+    }
+
+    free(tracePath);
+    tracePath = (char *) malloc(strlen(path) + 1);
+    if (!tracePath) {
+        perror("malloc");
+        abort();
+    }
+    strcpy(tracePath, path);
+    ggggc_tracing = 1;
+
+    if (!flushing) {
+        flushing = 1;
+        atexit(ggggc_traceFlush);
+    }
+}
+
+#ifdef __cplusplus
+}
+#endif